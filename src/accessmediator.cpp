@@ -3,14 +3,40 @@
 #include <QDebug>
 #include <QDBusMetaType>
 #include <QDBusConnection>
+#include <QFile>
 
+#include <algorithm>
+#include <vector>
+
+#include <arpa/inet.h>
 #include <fcntl.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <linux/netlink.h>
 #include <linux/connector.h>
 #include <linux/cn_proc.h>
+#include <linux/filter.h>
 
 #define CONTROL_DEVICE "/dev/v4l2loopback"
+#define DEVICE_PREFIX "/dev/video"
+
+// Hints and process events handled per wakeup before the other
+// sources get a turn
+static const int EPOLL_BATCH = 4;
+static const int HINT_BATCH = 32;
+static const int PROC_EVENT_BATCH = 16;
+static const int DRAIN_ROUNDS = 2;
+// Fallback for control devices without poll support
+static const int NOTIFY_POLL_INTERVAL_MS = 50;
+// Proc connector messages are the netlink header, the connector header
+// and the payload back to back, without padding
+static const size_t PROC_PAYLOAD_OFFSET = NLMSG_LENGTH(sizeof(struct cn_msg));
+static const size_t PROC_MESSAGE_SIZE = PROC_PAYLOAD_OFFSET + sizeof(struct proc_event);
+// Processes matched one by one in the socket filter, the jump offsets
+// are a byte wide
+static const int FILTER_MAX_PIDS = 128;
 
 enum v4l2_loopback_hint_type {
     HINT_UNKNOWN = 0,
@@ -46,32 +72,41 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, Pids &msg)
     return argument;
 }
 
-static void enableProcessEventListener(int nl_sock, bool enable)
+static QString devicePath(int node)
 {
-    int rc;
-    struct nl_data {
-        enum proc_cn_mcast_op cn_mcast;
-        struct cn_msg cn_msg;
-    };
-    struct nlcn_msg {
-        struct nlmsghdr nl_hdr;
-        struct nl_data nl_data;
-    };
+    return QStringLiteral(DEVICE_PREFIX "%1").arg(node);
+}
+
+// Node number of a /dev/videoN path, -1 for anything else
+static int deviceNode(const QString& path)
+{
+    if (!path.startsWith(QStringLiteral(DEVICE_PREFIX)))
+        return -1;
 
-    struct nlcn_msg nlcn_msg;
+    bool ok;
+    const int node = path.mid(sizeof(DEVICE_PREFIX) - 1).toInt(&ok);
+    return ok && node >= 0 ? node : -1;
+}
+
+static void enableProcessEventListener(int nl_sock, bool enable)
+{
+    const enum proc_cn_mcast_op op = enable ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+    uint8_t message[PROC_PAYLOAD_OFFSET + sizeof(op)] __attribute__((aligned(NLMSG_ALIGNTO)));
+    memset(message, 0, sizeof(message));
 
-    memset(&nlcn_msg, 0, sizeof(nlcn_msg));
-    nlcn_msg.nl_hdr.nlmsg_len = sizeof(nlcn_msg);
-    nlcn_msg.nl_hdr.nlmsg_pid = getpid();
-    nlcn_msg.nl_hdr.nlmsg_type = NLMSG_DONE;
+    struct nlmsghdr* nl_hdr = (struct nlmsghdr*)message;
+    nl_hdr->nlmsg_len = sizeof(message);
+    nl_hdr->nlmsg_pid = getpid();
+    nl_hdr->nlmsg_type = NLMSG_DONE;
 
-    nlcn_msg.nl_data.cn_msg.id.idx = CN_IDX_PROC;
-    nlcn_msg.nl_data.cn_msg.id.val = CN_VAL_PROC;
-    nlcn_msg.nl_data.cn_msg.len = sizeof(enum proc_cn_mcast_op);
+    struct cn_msg* cn_msg = (struct cn_msg*)NLMSG_DATA(nl_hdr);
+    cn_msg->id.idx = CN_IDX_PROC;
+    cn_msg->id.val = CN_VAL_PROC;
+    cn_msg->len = sizeof(op);
 
-    nlcn_msg.nl_data.cn_mcast = enable ? PROC_CN_MCAST_LISTEN : PROC_CN_MCAST_IGNORE;
+    memcpy(message + PROC_PAYLOAD_OFFSET, &op, sizeof(op));
 
-    rc = send(nl_sock, &nlcn_msg, sizeof(nlcn_msg), 0);
+    int rc = send(nl_sock, message, sizeof(message), 0);
     if (rc < 0) {
         qFatal("Failed to %s process event listener: %s", enable ? "enable" : "disable", strerror(errno));
         return;
@@ -80,20 +115,61 @@ static void enableProcessEventListener(int nl_sock, bool enable)
     return;
 }
 
+// Socket filter passing the exits of the given processes and nothing
+// else. Classic BPF loads words big endian while the connector speaks
+// host order, so constants are compared byte swapped.
+static std::vector<struct sock_filter> processExitFilter(const QVector<pid_t>& pids)
+{
+    const uint32_t idxOffset = NLMSG_HDRLEN + offsetof(struct cn_msg, id.idx);
+    const uint32_t valOffset = NLMSG_HDRLEN + offsetof(struct cn_msg, id.val);
+    const uint32_t whatOffset = PROC_PAYLOAD_OFFSET + offsetof(struct proc_event, what);
+    const uint32_t pidOffset = PROC_PAYLOAD_OFFSET + offsetof(struct proc_event, event_data.exit.process_pid);
+    const uint32_t tgidOffset = PROC_PAYLOAD_OFFSET + offsetof(struct proc_event, event_data.exit.process_tgid);
+
+    std::vector<struct sock_filter> program = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, idxOffset),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(CN_IDX_PROC), 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, valOffset),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(CN_VAL_PROC), 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, whatOffset),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(proc_cn_event::PROC_EVENT_EXIT), 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        // Every thread reports its exit, the process is gone once its
+        // main thread is
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, pidOffset),
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, tgidOffset),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+
+    if (pids.size() > FILTER_MAX_PIDS) {
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+        return program;
+    }
+
+    // The tgid is still in A, each match jumps to the accept at the end
+    for (int i = 0; i < pids.size(); i++)
+        program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pids[i]), (__u8)(pids.size() - i), 0));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffff));
+    return program;
+}
+
 AccessMediator::AccessMediator(QObject *parent) :
     QObject(parent),
-    m_notifyThread(new QThread(this)),
-    m_netlinkThread(new QThread(this)),
-    m_running(true)
+    m_eventThread(new QThread(this))
 {
-    this->m_notifyFd = open(CONTROL_DEVICE, O_RDONLY);
+    this->m_notifyFd = open(CONTROL_DEVICE, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
     if (this->m_notifyFd < 0) {
         qFatal("Failed to open control device: %s", strerror(errno));
         exit(2);
         return;
     }
 
-    this->m_netlinkFd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_CONNECTOR);
+    this->m_netlinkFd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
     if (this->m_netlinkFd < 0) {
         qWarning("Failed to open process event netlink socket: %s", strerror(errno));
     } else {
@@ -105,11 +181,35 @@ AccessMediator::AccessMediator(QObject *parent) :
         int rc = bind(this->m_netlinkFd, (struct sockaddr *)&procEventNl, sizeof(procEventNl));
         if (rc < 0) {
             qWarning("Failed to bind process event netlink socket: %s", strerror(errno));
+            close(this->m_netlinkFd);
+            this->m_netlinkFd = -1;
         } else {
+            // Nothing is tracked yet, so the filter starts out dropping everything
+            updateProcessFilter();
             enableProcessEventListener(this->m_netlinkFd, true);
         }
     }
 
+    this->m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    this->m_shutdownFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->m_epollFd < 0 || this->m_shutdownFd < 0) {
+        qFatal("Failed to set up access event loop: %s", strerror(errno));
+        exit(2);
+        return;
+    }
+
+    watch(this->m_shutdownFd);
+    watch(this->m_netlinkFd);
+    if (!watch(this->m_notifyFd)) {
+        if (errno != EPERM) {
+            qFatal("Failed to watch control device: %s", strerror(errno));
+            exit(2);
+            return;
+        }
+        qWarning("Control device can't be polled, reading hints on a timeout");
+        this->m_pollNotifyFd = true;
+    }
+
     qDBusRegisterMetaType<Pids>();
     qDebug() << QDBusConnection::sessionBus().connect("",
                                                       "/",
@@ -124,18 +224,19 @@ AccessMediator::AccessMediator(QObject *parent) :
                                                       this,
                                                       SLOT(appResumed(QString, Pids)));
 
-    QObject::connect(this->m_notifyThread, &QThread::started,
-                     this, &AccessMediator::runNotificationLoop, Qt::DirectConnection);
-    this->m_notifyThread->start();
-
-    QObject::connect(this->m_netlinkThread, &QThread::started,
-                     this, &AccessMediator::runProcessNotificationLoop, Qt::DirectConnection);
-    this->m_netlinkThread->start();
+    this->m_eventThread->setObjectName(QStringLiteral("access"));
+    QObject::connect(this->m_eventThread, &QThread::started,
+                     this, &AccessMediator::runEventLoop, Qt::DirectConnection);
+    this->m_eventThread->start();
 }
 
 AccessMediator::~AccessMediator()
 {
-    this->m_running = false;
+    // The loop wakes up on the eventfd and returns right away
+    const uint64_t wakeup = 1;
+    if (this->m_shutdownFd >= 0 && write(this->m_shutdownFd, &wakeup, sizeof(wakeup)) < 0)
+        qWarning("Failed to signal access event loop: %s", strerror(errno));
+    this->m_eventThread->wait();
 
     if (this->m_notifyFd >= 0)
         close(this->m_notifyFd);
@@ -145,156 +246,300 @@ AccessMediator::~AccessMediator()
         close(this->m_netlinkFd);
     }
 
-    this->m_notifyThread->terminate();
-    this->m_netlinkThread->terminate();
+    if (this->m_shutdownFd >= 0)
+        close(this->m_shutdownFd);
+    if (this->m_epollFd >= 0)
+        close(this->m_epollFd);
+}
 
-    this->m_notifyThread->wait(1000);
-    this->m_netlinkThread->wait(1000);
+bool AccessMediator::watch(int fd)
+{
+    if (fd < 0)
+        return false;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(this->m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void AccessMediator::unwatch(int* fd)
+{
+    // Broken sources are dropped instead of spinning on their errors
+    epoll_ctl(this->m_epollFd, EPOLL_CTL_DEL, *fd, nullptr);
+    if (*fd == this->m_notifyFd)
+        this->m_pollNotifyFd = false;
+    close(*fd);
+    *fd = -1;
 }
 
 void AccessMediator::appPaused(QString name, Pids pids)
 {
-    for (const auto& device : this->m_devices) {
-        const TrackingInfo& tracking = this->m_devices[device.first];
-        for (const int& pid : pids.pids) {
-            if (tracking.fdsPerPid.find(pid) != tracking.fdsPerPid.end()) {
-                emit deviceClosed(QString::fromStdString(device.first));
-            }
-        }
-    }
+    for (const QString& path : devicesOf(pids))
+        emit deviceClosed(path, name);
 }
 
 void AccessMediator::appResumed(QString name, Pids pids)
 {
-    for (const auto& device : this->m_devices) {
-        const TrackingInfo& tracking = this->m_devices[device.first];
-        for (const int& pid : pids.pids) {
-            if (tracking.fdsPerPid.find(pid) != tracking.fdsPerPid.end()) {
-                emit accessAllowed(QString::fromStdString(device.first));
-            }
+    for (const QString& path : devicesOf(pids))
+        emit accessAllowed(path, name);
+}
+
+QVector<QString> AccessMediator::devicesOf(const Pids& pids)
+{
+    // Every device once, however many of the app's processes hold it
+    QVector<QString> paths;
+    for (const int& pid : pids.pids) {
+        for (const QString& path : this->m_devices.devicesOf(pid)) {
+            if (!paths.contains(path))
+                paths.append(path);
         }
     }
+    return paths;
 }
 
-void AccessMediator::runProcessNotificationLoop()
+QString AccessMediator::processName(pid_t pid)
 {
-    int rc;
-    struct nl_data {
-        struct proc_event proc_ev;
-        struct cn_msg cn_msg;
-    };
-    struct nlcn_msg {
-        struct nlmsghdr nl_hdr;
-        struct nl_data nl_data;
-    };
+    QFile comm(QStringLiteral("/proc/%1/comm").arg(pid));
+    return comm.open(QIODevice::ReadOnly) ? QString::fromUtf8(comm.readAll()).trimmed()
+                                          : QString::number(pid);
+}
 
-    struct nlcn_msg nlcn_msg;
+QString AccessMediator::consumerOf(pid_t pid)
+{
+    auto it = this->m_consumers.find(pid);
+    if (it != this->m_consumers.end())
+        return it->second;
+
+    // Gone by the time of exit events, so looked up on first open
+    const QString name = processName(pid);
+    this->m_consumers[pid] = name;
+    return name;
+}
 
-    if (this->m_netlinkFd < 0)
-        return;
+void AccessMediator::forgetConsumer(pid_t pid)
+{
+    if (this->m_devices.devicesOf(pid).isEmpty())
+        this->m_consumers.erase(pid);
+}
 
-    while (this->m_running) {
-        rc = recv(this->m_netlinkFd, &nlcn_msg, sizeof(nlcn_msg), 0);
-        if (rc == 0) {
-            return;
-        } else if (rc < 0) {
-            if (errno == EINTR) continue;
-            qWarning("netlink recv");
-            return;
+void AccessMediator::runEventLoop()
+{
+    struct epoll_event events[EPOLL_BATCH];
+
+    for (;;) {
+        const int count = epoll_wait(this->m_epollFd, events, EPOLL_BATCH,
+                                     this->m_pollNotifyFd ? NOTIFY_POLL_INTERVAL_MS : -1);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            qWarning("Access event loop failed: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == this->m_shutdownFd) {
+                qInfo("Notification loop stopped!");
+                return;
+            }
         }
 
-        switch (nlcn_msg.nl_data.proc_ev.what) {
-            case proc_cn_event::PROC_EVENT_EXIT:
-            {
-                const auto& pid = nlcn_msg.nl_data.proc_ev.event_data.exit.process_tgid;
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == this->m_notifyFd)
+                drainNotifications();
+            else if (events[i].data.fd == this->m_netlinkFd)
+                drainProcessEvents();
+        }
 
-                for (const auto& device : this->m_devices) {
-                    std::map<int, int> &fdsPerPid = this->m_devices[device.first].fdsPerPid;
-                    if (fdsPerPid.find(pid) == fdsPerPid.end())
-                        continue;
+        if (this->m_pollNotifyFd)
+            drainNotifications();
+    }
+}
 
-                    fdsPerPid.erase(pid);
-                    qInfo("Device %s closed due to exit of %d", device.first.c_str(), pid);
-                    emit deviceClosed(QString::fromStdString(device.first));
-                }
+void AccessMediator::drainNotifications()
+{
+    // The control device hands out one hint per read, bounded so a flood
+    // of hints can't starve process events
+    for (int i = 0; i < HINT_BATCH && this->m_notifyFd >= 0; i++) {
+        struct v4l2_loopback_hint hint;
+        const ssize_t length = read(this->m_notifyFd, &hint, sizeof(hint));
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                qWarning("Failed to read from notification fd: %s", strerror(errno));
+                unwatch(&this->m_notifyFd);
             }
-                break;
-            default:
-                break;
+            return;
         }
+        if (length < (ssize_t)sizeof(hint))
+            return;
+
+        handleHint(hint);
     }
 }
 
-void AccessMediator::runNotificationLoop()
+void AccessMediator::handleHint(const struct v4l2_loopback_hint& hint)
 {
-    while (this->m_running)
-    {
-        static const int BUFSIZE = sizeof(struct v4l2_loopback_hint);
-        char buffer[BUFSIZE];
+    if (hint.type == HINT_UNKNOWN)
+        return;
 
-        const int length = read(this->m_notifyFd, buffer, BUFSIZE);
-        if (length < 0) {
-            qWarning("Failed to read from notification fd: %s", strerror(errno));
-            continue;
+    if (hint.pid == getpid())
+        return;
+
+    if (!this->m_devices.contains(hint.node))
+        return;
+
+    const QString deviceName = devicePath(hint.node);
+
+    switch (hint.type) {
+    case HINT_OPEN:
+        if (!this->m_devices.open(hint.node, hint.pid))
+            break;
+        updateProcessFilter();
+
+        qDebug() << "Device accessed by:" << hint.pid;
+        qInfo("Access allowed for %s", deviceName.toUtf8().data());
+        emit accessAllowed(deviceName, consumerOf(hint.pid));
+
+        break;
+    case HINT_CLOSE:
+        if (this->m_devices.close(hint.node, hint.pid)) {
+            qInfo("Device %s closed by %d", deviceName.toUtf8().data(), hint.pid);
+            emit deviceClosed(deviceName, consumerOf(hint.pid));
+            forgetConsumer(hint.pid);
+            updateProcessFilter();
         }
+        break;
+    default:
+        qDebug("Unknown hint type received: %d", hint.type);
+        break;
+    }
+}
 
-        struct v4l2_loopback_hint* hint = (struct v4l2_loopback_hint*) &buffer;
-        if (hint->type == HINT_UNKNOWN)
-            continue;
+void AccessMediator::drainProcessEvents()
+{
+    struct alignas(NLMSG_ALIGNTO) Message {
+        uint8_t data[PROC_MESSAGE_SIZE];
+    };
 
-        if (hint->pid == getpid())
-            continue;
+    Message messages[PROC_EVENT_BATCH];
+    struct iovec iovecs[PROC_EVENT_BATCH];
+    struct mmsghdr headers[PROC_EVENT_BATCH];
+
+    for (int round = 0; round < DRAIN_ROUNDS && this->m_netlinkFd >= 0; round++) {
+        memset(headers, 0, sizeof(headers));
+        for (int i = 0; i < PROC_EVENT_BATCH; i++) {
+            iovecs[i].iov_base = messages[i].data;
+            iovecs[i].iov_len = sizeof(messages[i].data);
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
 
-        const QString deviceName = QStringLiteral("/dev/video%1").arg(hint->node);
+        const int count = recvmmsg(this->m_netlinkFd, headers, PROC_EVENT_BATCH, MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            // Overruns lose events but the socket stays usable
+            if (errno == ENOBUFS) {
+                qWarning("Process events dropped by the kernel");
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                qWarning("netlink recv: %s", strerror(errno));
+                unwatch(&this->m_netlinkFd);
+            }
+            return;
+        }
 
-        if (this->m_devices.find(deviceName.toStdString()) == this->m_devices.end())
-            continue;
+        for (int i = 0; i < count; i++) {
+            // The payload sits unaligned behind the connector header.
+            // Older kernels send a shorter event, the tail stays zero.
+            if (headers[i].msg_len <= PROC_PAYLOAD_OFFSET)
+                continue;
+            struct proc_event event;
+            memset(&event, 0, sizeof(event));
+            memcpy(&event, messages[i].data + PROC_PAYLOAD_OFFSET,
+                   std::min<size_t>(headers[i].msg_len - PROC_PAYLOAD_OFFSET, sizeof(event)));
+            handleProcessEvent(event);
+        }
 
-        const std::string stdDeviceName = deviceName.toStdString();
-        std::map<int, int> &fdsPerPid = this->m_devices[stdDeviceName].fdsPerPid;
+        if (count < PROC_EVENT_BATCH)
+            return;
+    }
+}
 
-        switch (hint->type) {
-        case HINT_OPEN:
-            if (fdsPerPid.find(hint->pid) != fdsPerPid.end())
-                ++fdsPerPid[hint->pid];
-            else
-                fdsPerPid[hint->pid] = 1;
+void AccessMediator::handleProcessEvent(const struct proc_event& event)
+{
+    switch (event.what) {
+        case proc_cn_event::PROC_EVENT_EXIT:
+        {
+            // Threads other than the main one leave the process running
+            if (event.event_data.exit.process_pid != event.event_data.exit.process_tgid)
+                break;
 
-            qDebug() << "Device accessed by:" << hint->pid;
-            qInfo("Access allowed for %s", deviceName.toUtf8().data());
-            emit accessAllowed(deviceName);
+            const auto& pid = event.event_data.exit.process_tgid;
 
-            break;
-        case HINT_CLOSE:
-            if (--fdsPerPid[hint->pid] <= 0) {
-                fdsPerPid.erase(hint->pid);
-                qInfo("Device %s closed by %d", deviceName.toUtf8().data(), hint->pid);
-                emit deviceClosed(deviceName);
+            const QVector<QString> paths = this->m_devices.removePid(pid);
+            if (paths.isEmpty())
+                break;
+
+            const QString consumer = consumerOf(pid);
+            for (const QString& path : paths) {
+                qInfo("Device %s closed due to exit of %d", path.toUtf8().data(), pid);
+                emit deviceClosed(path, consumer);
             }
+            forgetConsumer(pid);
+            updateProcessFilter();
+        }
             break;
         default:
-            qDebug("Unknown hint type received: %d", hint->type);
             break;
-        }
+    }
+}
+
+void AccessMediator::updateProcessFilter()
+{
+    if (this->m_netlinkFd < 0 || this->m_filterFailed)
+        return;
+
+    // Exits slipping through before the filter catches up with a new
+    // pid still arrive as close hints for the fds the process held
+    const QVector<pid_t> pids = this->m_devices.pids();
+    if (this->m_filterAttached && pids == this->m_filteredPids)
+        return;
+
+    std::vector<struct sock_filter> program = processExitFilter(pids);
+    struct sock_fprog filter;
+    filter.len = program.size();
+    filter.filter = program.data();
+
+    if (setsockopt(this->m_netlinkFd, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) < 0) {
+        // Every event wakes us up without the filter, none get lost
+        qWarning("Failed to filter process events: %s", strerror(errno));
+        this->m_filterFailed = true;
+        return;
     }
 
-    qInfo("Notification loop stopped!");
+    this->m_filterAttached = true;
+    this->m_filteredPids = pids;
 }
 
 void AccessMediator::registerDevice(const QString path)
 {
-    TrackingInfo info;
-    this->m_devices.insert({path.toStdString(), info});
+    const int node = deviceNode(path);
+    if (node < 0 || !this->m_devices.add(node, path)) {
+        qWarning("Device %s not registered, skipping...", path.toUtf8().data());
+        return;
+    }
     qInfo("Registered watcher for node %s", path.toUtf8().data());
 }
 
 void AccessMediator::unregisterDevice(const QString path)
 {
-    const std::string stdPath = path.toStdString();
-    if (this->m_devices.find(stdPath) == this->m_devices.end()) {
+    if (!this->m_devices.remove(deviceNode(path))) {
         qWarning("Device %s not registered, skipping...", path.toUtf8().data());
         return;
     }
-
-    this->m_devices.erase(stdPath);
 }
@@ -8,15 +8,15 @@
 #include <QVector>
 #include <QVariant>
 
-#include <map>
-#include <set>
-#include <vector>
-
+#include <sys/types.h>
 #include <unistd.h>
 
-struct TrackingInfo {
-    std::map<pid_t, int> fdsPerPid;
-};
+#include <unordered_map>
+
+#include "devicetable.h"
+
+struct v4l2_loopback_hint;
+struct proc_event;
 
 struct Pids
 {
@@ -31,6 +31,9 @@ public:
     explicit AccessMediator(QObject *parent = nullptr);
     ~AccessMediator();
 
+    // Executable name of pid from /proc, the pid itself if it is gone
+    static QString processName(pid_t pid);
+
 public slots:
     void registerDevice(const QString path);
     void unregisterDevice(const QString path);
@@ -40,21 +43,43 @@ private slots:
     void appResumed(QString name, Pids pids);
 
 private:
-    void runNotificationLoop();
-    void runProcessNotificationLoop();
+    // Waits on both event sources and the shutdown eventfd, on m_eventThread
+    void runEventLoop();
+    bool watch(int fd);
+    void unwatch(int* fd);
+    void drainNotifications();
+    void drainProcessEvents();
+    void handleHint(const struct v4l2_loopback_hint& hint);
+    void handleProcessEvent(const struct proc_event& event);
+    // Narrows the netlink socket down to exits of processes holding a
+    // device, called on the event thread whenever that set may change
+    void updateProcessFilter();
+    QVector<QString> devicesOf(const Pids& pids);
+    // Executable name of pid, remembered while it holds a device
+    QString consumerOf(pid_t pid);
+    void forgetConsumer(pid_t pid);
 
-    bool m_running;
-    QThread* m_notifyThread;
-    QThread* m_netlinkThread;
-    int m_notifyFd;
-    int m_netlinkFd;
-    std::map<std::string, TrackingInfo> m_devices;
+    QThread* m_eventThread;
+    int m_epollFd = -1;
+    int m_shutdownFd = -1;
+    int m_notifyFd = -1;
+    int m_netlinkFd = -1;
+    // Control devices without poll support are read on a timeout instead
+    bool m_pollNotifyFd = false;
+    DeviceTable m_devices;
+    // Pids the attached socket filter passes exits of
+    QVector<pid_t> m_filteredPids;
+    bool m_filterAttached = false;
+    bool m_filterFailed = false;
+    // Only touched on m_eventThread
+    std::unordered_map<pid_t, QString> m_consumers;
 
 signals:
     void permitted(const quint64 pid);
     void denied(const quint64 pid);
-    void accessAllowed(const QString path);
-    void deviceClosed(const QString path);
+    // consumer names the process or app opening or closing the device
+    void accessAllowed(const QString path, const QString consumer);
+    void deviceClosed(const QString path, const QString consumer);
 };
 
 #endif // ACCESSMEDIATOR_H
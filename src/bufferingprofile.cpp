@@ -0,0 +1,46 @@
+#include "bufferingprofile.h"
+
+static const BufferingProfile ALL_PROFILES[] = {
+    BufferingProfile::LowLatency,
+    BufferingProfile::Smooth,
+    BufferingProfile::Recording,
+};
+
+BufferingSettings bufferingSettings(BufferingProfile profile)
+{
+    switch (profile) {
+    case BufferingProfile::LowLatency:
+        // The pacer already keeps only the newest frame, streaming I/O
+        // still gets its second buffer
+        return { 1, 0, BufferingSettings::DropOldest, 50 };
+    case BufferingProfile::Smooth:
+        return { 4, 2, BufferingSettings::DropOldest, 150 };
+    case BufferingProfile::Recording:
+        return { 8, 8, BufferingSettings::DropNewest, 1000 };
+    }
+    return { 1, 0, BufferingSettings::DropOldest, 50 };
+}
+
+QString bufferingProfileName(BufferingProfile profile)
+{
+    switch (profile) {
+    case BufferingProfile::LowLatency:
+        return QStringLiteral("low-latency");
+    case BufferingProfile::Smooth:
+        return QStringLiteral("smooth");
+    case BufferingProfile::Recording:
+        return QStringLiteral("recording");
+    }
+    return QString();
+}
+
+bool parseBufferingProfile(const QString& name, BufferingProfile* profile)
+{
+    for (const BufferingProfile candidate : ALL_PROFILES) {
+        if (bufferingProfileName(candidate) == name.toLower()) {
+            *profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#ifndef BUFFERINGPROFILE_H
+#define BUFFERINGPROFILE_H
+
+#include <QString>
+
+#include <cstddef>
+
+// How a loopback device trades latency for smoothness
+enum class BufferingProfile {
+    // As few device buffers as the I/O mode allows, one with write()
+    // and two with streaming I/O. Frames are written on the delivering
+    // thread and only the newest pending one goes out.
+    LowLatency,
+    // A few device buffers for consumers that stall briefly, and a
+    // short writer queue
+    Smooth,
+    // Deep device buffers and writer queue, nothing overtakes a frame
+    Recording
+};
+
+struct BufferingSettings {
+    enum DropPolicy {
+        // A frame arriving at a full queue pushes out the oldest one
+        DropOldest,
+        // A frame arriving at a full queue is dropped
+        DropNewest
+    };
+
+    // Device buffers, consumers falling further behind skip ahead.
+    // Streaming I/O raises it to the two buffers it needs at least.
+    unsigned int deviceBuffers;
+    // Frames waiting for the sink's writer thread, 0 writes on the
+    // thread delivering the frame
+    size_t queueDepth;
+    DropPolicy dropPolicy;
+    // Frames written later than this after capture count as late
+    int lateAfterMs;
+};
+
+BufferingSettings bufferingSettings(BufferingProfile profile);
+
+QString bufferingProfileName(BufferingProfile profile);
+bool parseBufferingProfile(const QString& name, BufferingProfile* profile);
+
+#endif // BUFFERINGPROFILE_H
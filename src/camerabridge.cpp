@@ -0,0 +1,110 @@
+#include "camerabridge.h"
+
+#include <QDebug>
+
+CameraBridge::CameraBridge(std::shared_ptr<FrameSource> source,
+                           std::shared_ptr<V4L2LoopbackSink> sink,
+                           QObject *parent) :
+    QObject(parent),
+    m_source(source),
+    m_sink(sink),
+    m_deviceOpen(false),
+    m_ringClients(0)
+{
+    // Frame passing through one-way communication from source to sink
+    QObject::connect(this->m_source.get(), &FrameSource::captured,
+                     this->m_sink.get(), &V4L2LoopbackSink::pushCapture, Qt::DirectConnection);
+
+    QObject::connect(this->m_sink.get(), &V4L2LoopbackSink::frameRateRequested,
+                     this, &CameraBridge::applyFrameRate);
+}
+
+FrameSource* CameraBridge::source()
+{
+    return this->m_source.get();
+}
+
+V4L2LoopbackSink* CameraBridge::sink()
+{
+    return this->m_sink.get();
+}
+
+void CameraBridge::setSharedMemorySink(std::shared_ptr<SharedMemorySink> ring)
+{
+    this->m_ring = ring;
+    this->m_ring->setFormat(this->m_source->format());
+
+    QObject::connect(this->m_source.get(), &FrameSource::captured,
+                     this->m_ring.get(), &SharedMemorySink::pushCapture, Qt::DirectConnection);
+    QObject::connect(this->m_ring.get(), &SharedMemorySink::clientConnected,
+                     this, &CameraBridge::ringClientConnected);
+    QObject::connect(this->m_ring.get(), &SharedMemorySink::clientDisconnected,
+                     this, &CameraBridge::ringClientDisconnected);
+}
+
+SharedMemorySink* CameraBridge::sharedMemorySink()
+{
+    return this->m_ring.get();
+}
+
+bool CameraBridge::setTransform(const FrameTransform& transform)
+{
+    if (!this->m_source->setTransform(transform))
+        return false;
+
+    this->m_transform = transform.normalized();
+    qInfo() << this->m_sink->path() << transform;
+    return true;
+}
+
+FrameTransform CameraBridge::transform()
+{
+    return this->m_transform;
+}
+
+void CameraBridge::accessAllowed(const QString path, const QString consumer)
+{
+    if (path != this->m_sink->path())
+        return;
+
+    // The source hears about the consumer ahead of start, so its stop
+    // delay can follow the consumer later on
+    this->m_deviceOpen = true;
+    this->m_source->consumerOpened(consumer);
+    this->m_sink->deviceOpened();
+    this->m_source->start();
+}
+
+void CameraBridge::deviceClosed(const QString path, const QString consumer)
+{
+    if (path != this->m_sink->path())
+        return;
+
+    this->m_deviceOpen = false;
+    this->m_source->consumerClosed(consumer);
+    if (this->m_ringClients == 0)
+        this->m_source->stop();
+}
+
+void CameraBridge::applyFrameRate(int fps)
+{
+    // The source gets as close as it can, the sink paces to the exact
+    // rate by dropping or repeating frames
+    this->m_source->setFrameRate(fps);
+    this->m_sink->setFrameRate(fps);
+}
+
+void CameraBridge::ringClientConnected(const QString consumer)
+{
+    // Ring clients take whatever format the device has
+    ++this->m_ringClients;
+    this->m_source->consumerOpened(consumer);
+    this->m_source->start();
+}
+
+void CameraBridge::ringClientDisconnected(const QString consumer)
+{
+    this->m_source->consumerClosed(consumer);
+    if (--this->m_ringClients == 0 && !this->m_deviceOpen)
+        this->m_source->stop();
+}
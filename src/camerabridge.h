@@ -0,0 +1,59 @@
+#ifndef CAMERABRIDGE_H
+#define CAMERABRIDGE_H
+
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+#include "framesource.h"
+#include "sharedmemorysink.h"
+#include "v4l2loopbacksink.h"
+
+// One source exposed through one loopback device, and optionally a
+// shared memory ring. Wires frames and rate requests between
+// them and reacts to access events of its own device only, so opening
+// one camera leaves the others asleep.
+class CameraBridge : public QObject
+{
+    Q_OBJECT
+
+public:
+    CameraBridge(std::shared_ptr<FrameSource> source,
+                 std::shared_ptr<V4L2LoopbackSink> sink,
+                 QObject *parent = nullptr);
+
+    FrameSource* source();
+    V4L2LoopbackSink* sink();
+
+    // Also feeds frames to the ring's clients, the source runs as long as
+    // either the device or the ring has someone reading
+    void setSharedMemorySink(std::shared_ptr<SharedMemorySink> ring);
+    SharedMemorySink* sharedMemorySink();
+
+    // Geometry of this device's frames, false if the source refused
+    bool setTransform(const FrameTransform& transform);
+    FrameTransform transform();
+
+public slots:
+    // From any thread, events for other devices are ignored
+    void accessAllowed(const QString path, const QString consumer);
+    void deviceClosed(const QString path, const QString consumer);
+
+private slots:
+    void applyFrameRate(int fps);
+    void ringClientConnected(const QString consumer);
+    void ringClientDisconnected(const QString consumer);
+
+private:
+    std::shared_ptr<FrameSource> m_source;
+    std::shared_ptr<V4L2LoopbackSink> m_sink;
+    std::shared_ptr<SharedMemorySink> m_ring;
+    FrameTransform m_transform;
+    // Device events arrive on the mediator's thread, ring events on ours
+    std::atomic<bool> m_deviceOpen;
+    std::atomic<int> m_ringClients;
+};
+
+#endif // CAMERABRIDGE_H
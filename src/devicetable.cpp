@@ -0,0 +1,120 @@
+#include "devicetable.h"
+
+#include <algorithm>
+
+bool DeviceTable::add(int node, const QString& path)
+{
+    QWriteLocker locker(&this->m_lock);
+
+    Device device;
+    device.path = path;
+    return this->m_devices.insert({node, device}).second;
+}
+
+bool DeviceTable::remove(int node)
+{
+    QWriteLocker locker(&this->m_lock);
+
+    auto it = this->m_devices.find(node);
+    if (it == this->m_devices.end())
+        return false;
+
+    for (const auto& opener : it->second.openers)
+        unindex(opener.first, node);
+    this->m_devices.erase(it);
+    return true;
+}
+
+bool DeviceTable::contains(int node) const
+{
+    QReadLocker locker(&this->m_lock);
+    return this->m_devices.find(node) != this->m_devices.end();
+}
+
+bool DeviceTable::open(int node, pid_t pid)
+{
+    QWriteLocker locker(&this->m_lock);
+
+    auto it = this->m_devices.find(node);
+    if (it == this->m_devices.end())
+        return false;
+
+    if (++it->second.openers[pid] == 1)
+        this->m_nodesByPid[pid].append(node);
+    return true;
+}
+
+bool DeviceTable::close(int node, pid_t pid)
+{
+    QWriteLocker locker(&this->m_lock);
+
+    auto it = this->m_devices.find(node);
+    if (it == this->m_devices.end())
+        return false;
+
+    // A pid opened before we started watching closes without an open
+    auto opener = it->second.openers.find(pid);
+    if (opener == it->second.openers.end())
+        return true;
+    if (--opener->second > 0)
+        return false;
+
+    it->second.openers.erase(opener);
+    unindex(pid, node);
+    return true;
+}
+
+QVector<QString> DeviceTable::devicesOf(pid_t pid) const
+{
+    QReadLocker locker(&this->m_lock);
+
+    QVector<QString> paths;
+    auto nodes = this->m_nodesByPid.find(pid);
+    if (nodes == this->m_nodesByPid.end())
+        return paths;
+
+    for (int node : nodes->second)
+        paths.append(this->m_devices.at(node).path);
+    return paths;
+}
+
+QVector<QString> DeviceTable::removePid(pid_t pid)
+{
+    QWriteLocker locker(&this->m_lock);
+
+    QVector<QString> paths;
+    auto nodes = this->m_nodesByPid.find(pid);
+    if (nodes == this->m_nodesByPid.end())
+        return paths;
+
+    for (int node : nodes->second) {
+        Device& device = this->m_devices.at(node);
+        device.openers.erase(pid);
+        paths.append(device.path);
+    }
+    this->m_nodesByPid.erase(nodes);
+    return paths;
+}
+
+QVector<pid_t> DeviceTable::pids() const
+{
+    QReadLocker locker(&this->m_lock);
+
+    QVector<pid_t> pids;
+    pids.reserve(this->m_nodesByPid.size());
+    for (const auto& nodes : this->m_nodesByPid)
+        pids.append(nodes.first);
+    std::sort(pids.begin(), pids.end());
+    return pids;
+}
+
+void DeviceTable::unindex(pid_t pid, int node)
+{
+    auto nodes = this->m_nodesByPid.find(pid);
+    if (nodes == this->m_nodesByPid.end())
+        return;
+
+    nodes->second.removeAll(node);
+    if (nodes->second.isEmpty())
+        this->m_nodesByPid.erase(nodes);
+}
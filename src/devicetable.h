@@ -0,0 +1,48 @@
+#ifndef DEVICETABLE_H
+#define DEVICETABLE_H
+
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+
+#include <unordered_map>
+
+#include <sys/types.h>
+
+// Loopback devices keyed by node number with the processes holding
+// them open, plus the reverse index from pid to nodes so per process
+// events don't scan every device. Safe to use from any thread.
+class DeviceTable
+{
+public:
+    bool add(int node, const QString& path);
+    bool remove(int node);
+    bool contains(int node) const;
+
+    // Counts an open() by pid, false for unknown devices
+    bool open(int node, pid_t pid);
+    // Counts a close() by pid, true once the pid closed its last fd
+    bool close(int node, pid_t pid);
+
+    // Paths of the devices pid has open
+    QVector<QString> devicesOf(pid_t pid) const;
+    // Forgets pid, returns the paths of the devices it had open
+    QVector<QString> removePid(pid_t pid);
+    // Every pid with a device open, in ascending order
+    QVector<pid_t> pids() const;
+
+private:
+    struct Device {
+        QString path;
+        // Open fds per pid
+        std::unordered_map<pid_t, int> openers;
+    };
+
+    void unindex(pid_t pid, int node);
+
+    mutable QReadWriteLock m_lock;
+    std::unordered_map<int, Device> m_devices;
+    std::unordered_map<pid_t, QVector<int>> m_nodesByPid;
+};
+
+#endif // DEVICETABLE_H
@@ -1,5 +1,7 @@
 #include <QDebug>
 
+#include <cstdio>
+
 #include "eglhelper.h"
 
 bool initEgl(EGLContext* eglContext, EGLDisplay* eglDisplay, EGLSurface* eglSurface)
@@ -21,54 +23,141 @@ bool initEgl(EGLContext* eglContext, EGLDisplay* eglDisplay, EGLSurface* eglSurf
 
     eglBindAPI(EGL_OPENGL_ES_API);
 
-    const EGLint attribs[] = {
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
-        EGL_BLUE_SIZE, 8,
-        EGL_GREEN_SIZE, 8,
-        EGL_RED_SIZE, 8,
-        EGL_ALPHA_SIZE, 8,
+    // Rendering only happens into framebuffer objects, sized per camera
+    EGLint pbufferAttribs[] = {
+        EGL_WIDTH, 1,
+        EGL_HEIGHT, 1,
         EGL_NONE
     };
 
-    EGLint context_attributes[] = {
-        EGL_CONTEXT_CLIENT_VERSION, 2,
+    // Prefer GLES3 for asynchronous readback, GLES2 is enough otherwise
+    context = EGL_NO_CONTEXT;
+    surface = EGL_NO_SURFACE;
+    for (const EGLint clientVersion : { 3, 2 }) {
+        const EGLint attribs[] = {
+            EGL_RENDERABLE_TYPE, clientVersion >= 3 ? EGL_OPENGL_ES3_BIT_KHR : EGL_OPENGL_ES2_BIT,
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_BLUE_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_RED_SIZE, 8,
+            EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+
+        EGLint context_attributes[] = {
+            EGL_CONTEXT_CLIENT_VERSION, clientVersion,
+            EGL_NONE
+        };
+
+        int config;
+        if (!eglChooseConfig(display, attribs, &eglConfig, 1, &config) || config == 0) {
+            qDebug() << "No EGL config found for GLES" << clientVersion;
+            continue;
+        }
+
+        context = eglCreateContext(display, eglConfig, 0, context_attributes);
+        if (context == EGL_NO_CONTEXT) {
+            qDebug() << "No GLES" << clientVersion << "context created.";
+            continue;
+        }
+
+        qInfo() << "Using GLES" << clientVersion << "context";
+        break;
+    }
+
+    if (context == EGL_NO_CONTEXT) {
+        qWarning() << "No context created.";
+        return false;
+    }
+
+    surface = eglCreatePbufferSurface(display, eglConfig, pbufferAttribs);
+    if (surface == EGL_NO_SURFACE) {
+        qWarning() << "No surface created.";
+        return false;
+    }
+
+    eglMakeCurrent(display, surface, surface, context);
+    *eglContext = context;
+    *eglDisplay = display;
+    *eglSurface = surface;
+    return true;
+}
+
+bool createSharedEglContext(EGLDisplay display, EGLContext shareContext,
+                            EGLContext* eglContext, EGLSurface* eglSurface)
+{
+    EGLint configId = 0;
+    EGLint clientVersion = 2;
+    eglQueryContext(display, shareContext, EGL_CONFIG_ID, &configId);
+    eglQueryContext(display, shareContext, EGL_CONTEXT_CLIENT_VERSION, &clientVersion);
+
+    const EGLint attribs[] = {
+        EGL_CONFIG_ID, configId,
         EGL_NONE
     };
 
-    EGLint pbufferAttribs[] = {
-        EGL_WIDTH, 1280,
-        EGL_HEIGHT, 720,
+    EGLConfig eglConfig;
+    int config = 0;
+    if (!eglChooseConfig(display, attribs, &eglConfig, 1, &config) || config == 0) {
+        qWarning() << "No EGL config found for id" << configId;
+        return false;
+    }
+
+    // Rendering only happens into framebuffer objects
+    const EGLint pbufferAttribs[] = {
+        EGL_WIDTH, 1,
+        EGL_HEIGHT, 1,
         EGL_NONE
     };
 
-    int config;
-    eglChooseConfig(display, attribs, &eglConfig, 1, &config);
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_CLIENT_VERSION, clientVersion,
+        EGL_NONE
+    };
 
-    if (config == 0) {
-        qWarning() << "No EGL config found:" << config;
-        return false;
-    }
+    eglBindAPI(EGL_OPENGL_ES_API);
 
-    surface = eglCreatePbufferSurface(display, eglConfig, pbufferAttribs);
+    EGLSurface surface = eglCreatePbufferSurface(display, eglConfig, pbufferAttribs);
     if (surface == EGL_NO_SURFACE) {
         qWarning() << "No surface created.";
         return false;
     }
 
-    context = eglCreateContext(display, eglConfig, 0, context_attributes);
+    EGLContext context = eglCreateContext(display, eglConfig, shareContext, context_attributes);
     if (context == EGL_NO_CONTEXT) {
-        qWarning() << "No context created.";
+        qWarning() << "No shared context created.";
+        eglDestroySurface(display, surface);
         return false;
     }
 
-    eglMakeCurrent(display, surface, surface, context);
     *eglContext = context;
-    *eglDisplay = display;
     *eglSurface = surface;
     return true;
 }
 
+void destroyEglContext(EGLDisplay display, EGLContext context, EGLSurface surface)
+{
+    if (eglGetCurrentContext() == context)
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+
+    eglReleaseThread();
+}
+
+int glesMajorVersion()
+{
+    // "OpenGL ES N.M ..."
+    const char* version = (const char*)glGetString(GL_VERSION);
+    int major = 2;
+    if (version && sscanf(version, "OpenGL ES %d", &major) != 1)
+        major = 2;
+    return major;
+}
+
 void provideFramebuffer(GLuint* fbo)
 {
     glGenFramebuffers(1, fbo);
@@ -85,6 +174,71 @@ void provideTexture(GLuint* texture)
     qDebug() << "New texture:" << *texture << glGetError();
 }
 
+void provideRenderTarget(GLuint* texture, GLsizei width, GLsizei height)
+{
+    glGenTextures(1, texture);
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    qDebug() << "New render target:" << *texture << width << height << glGetError();
+}
+
+static GLuint compileShader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        qWarning() << "Failed to compile shader:" << log;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+GLuint provideProgram(const char* vertexSource, const char* fragmentSource)
+{
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    // Shaders are kept alive by the program
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        qWarning() << "Failed to link program:" << log;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    qDebug() << "New program:" << program;
+    return program;
+}
+
 void provideExternalTexture(GLuint* texture)
 {
     glGenTextures(1, texture);
@@ -2,12 +2,19 @@
 #define EGLHELPER_H
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
 bool initEgl(EGLContext* eglContext, EGLDisplay* eglDisplay, EGLSurface* eglSurface);
+int glesMajorVersion();
+bool createSharedEglContext(EGLDisplay eglDisplay, EGLContext shareContext,
+                            EGLContext* eglContext, EGLSurface* eglSurface);
+void destroyEglContext(EGLDisplay eglDisplay, EGLContext eglContext, EGLSurface eglSurface);
 void provideFramebuffer(GLuint* fbo);
 void provideExternalTexture(GLuint* texture);
 void provideTexture(GLuint* texture);
+void provideRenderTarget(GLuint* texture, GLsizei width, GLsizei height);
+GLuint provideProgram(const char* vertexSource, const char* fragmentSource);
 
 #endif // EGLHELPER_H
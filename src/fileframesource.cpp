@@ -0,0 +1,133 @@
+#include "fileframesource.h"
+
+#include <QDebug>
+#include <QMetaObject>
+
+FileFrameSource::FileFrameSource(const QString& path, size_t width, size_t height, int fps,
+                                 PixelFormat format, QObject *parent) :
+    FrameSource(parent),
+    m_width(width),
+    m_height(height),
+    m_fps(fps > 0 ? fps : 30),
+    m_format(format),
+    m_file(path),
+    m_framePool(new FramePool(pixelFormatFrameSize(format, width, height)))
+{
+    if (!this->m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open replay file" << path << this->m_file.errorString();
+    } else if (this->m_file.size() < (qint64)this->m_framePool->bufferSize()) {
+        qWarning() << "Replay file" << path << "is smaller than a single frame";
+        this->m_file.close();
+    }
+
+    this->m_frameTimer.setTimerType(Qt::PreciseTimer);
+    this->m_frameTimer.setInterval(1000 / this->m_fps);
+    QObject::connect(&this->m_frameTimer, &QTimer::timeout,
+                     this, &FileFrameSource::produceFrame);
+
+    qInfo() << "Replaying" << path << this->m_width << this->m_height
+            << pixelFormatName(this->m_format) << "at" << this->m_fps << "fps";
+}
+
+FileFrameSource::~FileFrameSource()
+{
+    this->m_frameTimer.stop();
+}
+
+size_t FileFrameSource::width()
+{
+    return this->m_width;
+}
+
+size_t FileFrameSource::height()
+{
+    return this->m_height;
+}
+
+PixelFormat FileFrameSource::pixelFormat()
+{
+    return this->m_format;
+}
+
+int FileFrameSource::frameRate()
+{
+    return this->m_fps;
+}
+
+bool FileFrameSource::setFrameRate(int fps)
+{
+    if (fps <= 0)
+        return false;
+
+    this->m_fps = fps;
+    this->m_frameTimer.setInterval(1000 / this->m_fps);
+    return true;
+}
+
+void FileFrameSource::setQueueDepth(size_t frames)
+{
+    FrameSource::setQueueDepth(frames);
+    this->m_framePool.reset(new FramePool(this->m_framePool->bufferSize(),
+                                          FramePool::DEFAULT_BUFFER_COUNT + frames));
+}
+
+void FileFrameSource::start()
+{
+    if (!this->m_file.isOpen())
+        return;
+
+    QMetaObject::invokeMethod(this, "queueStart", Qt::QueuedConnection);
+}
+
+void FileFrameSource::queueStart()
+{
+    qDebug() << "Starting replay";
+    this->m_frameTimer.start();
+}
+
+void FileFrameSource::stop()
+{
+    QMetaObject::invokeMethod(this, "queueStop", Qt::QueuedConnection);
+}
+
+void FileFrameSource::queueStop()
+{
+    qDebug() << "Stopping replay";
+    this->m_frameTimer.stop();
+    qInfo() << this->m_framePool->stats();
+}
+
+bool FileFrameSource::readFrame(FrameRef& frame)
+{
+    const qint64 frameSize = frame.size();
+    return this->m_file.read((char*)frame.data(), frameSize) == frameSize;
+}
+
+void FileFrameSource::produceFrame()
+{
+    // Stamped when due rather than when read, reading may take a while
+    const quint64 timestamp = monotonicNanoseconds();
+    const quint64 sequence = ++this->m_sequence;
+
+    FrameRef frame = this->m_framePool->acquire();
+    if (frame.isNull()) {
+        if (this->m_stats)
+            ++this->m_stats->dropped;
+        return;
+    }
+
+    // Trailing partial frames are skipped, replay restarts from the top
+    if (!readFrame(frame)) {
+        this->m_file.seek(0);
+        if (!readFrame(frame)) {
+            qWarning() << "Failed to read frame from replay file" << this->m_file.fileName();
+            this->m_frameTimer.stop();
+            return;
+        }
+    }
+
+    frame.setTiming(timestamp, sequence);
+    if (this->m_stats)
+        ++this->m_stats->produced;
+    emit captured(frame);
+}
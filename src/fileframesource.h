@@ -0,0 +1,60 @@
+#ifndef FILEFRAMESOURCE_H
+#define FILEFRAMESOURCE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QTimer>
+
+#include <memory>
+
+#include "framepool.h"
+#include "framesource.h"
+#include "videoformat.h"
+
+// Replays raw frames of the given size and format from a file in a loop.
+class FileFrameSource : public FrameSource
+{
+    Q_OBJECT
+
+public:
+    explicit FileFrameSource(const QString& path,
+                             size_t width = 1280,
+                             size_t height = 720,
+                             int fps = 30,
+                             PixelFormat format = PixelFormat::Rgba32,
+                             QObject *parent = nullptr);
+    ~FileFrameSource();
+    void start() override;
+    void stop() override;
+
+    size_t width() override;
+    size_t height() override;
+    PixelFormat pixelFormat() override;
+
+    int frameRate() override;
+    bool setFrameRate(int fps) override;
+
+    void setQueueDepth(size_t frames) override;
+
+private slots:
+    void queueStart();
+    void queueStop();
+    void produceFrame();
+
+private:
+    bool readFrame(FrameRef& frame);
+
+    size_t m_width = 0;
+    size_t m_height = 0;
+    int m_fps = 30;
+    PixelFormat m_format = PixelFormat::Rgba32;
+    QFile m_file;
+    std::unique_ptr<FramePool> m_framePool;
+    // Frames produced, replays keep counting
+    quint64 m_sequence = 0;
+    QTimer m_frameTimer;
+};
+
+#endif // FILEFRAMESOURCE_H
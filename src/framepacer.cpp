@@ -0,0 +1,215 @@
+#include "framepacer.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// Time without new frames after which the source counts as stopped
+static const int IDLE_TIMEOUT_MS = 500;
+
+class FramePacerThread : public QThread
+{
+public:
+    explicit FramePacerThread(FramePacer* pacer) : m_pacer(pacer) {}
+
+protected:
+    void run() override { this->m_pacer->runTicks(); }
+
+private:
+    FramePacer* m_pacer;
+};
+
+FramePacer::FramePacer(QObject *parent) : QObject(parent)
+{
+    // Blocking, the tick thread sleeps in read() between ticks
+    this->m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (this->m_timerFd < 0) {
+        qWarning("Failed to create pacing timerfd: %s", strerror(errno));
+        return;
+    }
+
+    this->m_thread = new FramePacerThread(this);
+    this->m_thread->setObjectName(QStringLiteral("pacer"));
+    this->m_thread->start();
+}
+
+FramePacer::~FramePacer()
+{
+    stop();
+
+    if (this->m_timerFd >= 0)
+        close(this->m_timerFd);
+}
+
+void FramePacer::stop()
+{
+    if (!this->m_thread)
+        return;
+
+    {
+        // An expiry right away wakes the thread up to see m_quit
+        QMutexLocker locker(&this->m_mutex);
+        this->m_quit = true;
+        this->m_fps = 0;
+        this->m_pending.reset();
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_nsec = 1;
+        timerfd_settime(this->m_timerFd, 0, &spec, nullptr);
+        this->m_armed = false;
+    }
+
+    this->m_thread->wait();
+    delete this->m_thread;
+    this->m_thread = nullptr;
+}
+
+void FramePacer::setFrameRate(int fps)
+{
+    QMutexLocker locker(&this->m_mutex);
+
+    // Without a tick thread frames can only pass through
+    this->m_fps = this->m_timerFd >= 0 && !this->m_quit && fps > 0 ? fps : 0;
+    if (this->m_fps == 0)
+        this->m_pending.reset();
+    if (this->m_armed)
+        arm(this->m_fps > 0);
+}
+
+int FramePacer::frameRate()
+{
+    QMutexLocker locker(&this->m_mutex);
+    return this->m_fps;
+}
+
+void FramePacer::submit(FrameRef frame)
+{
+    if (frame.isNull())
+        return;
+
+    {
+        QMutexLocker locker(&this->m_mutex);
+        if (this->m_fps > 0) {
+            if (this->m_fresh) {
+                ++this->m_stats.dropped;
+                if (this->m_pipelineStats)
+                    ++this->m_pipelineStats->dropped;
+            }
+            this->m_pending = frame;
+            this->m_fresh = true;
+            this->m_idleTicks = 0;
+            if (!this->m_armed)
+                arm(true);
+            return;
+        }
+        ++this->m_stats.delivered;
+    }
+
+    emit frameDue(frame);
+}
+
+void FramePacer::reset()
+{
+    QMutexLocker locker(&this->m_mutex);
+    this->m_pending.reset();
+    this->m_fresh = false;
+    if (this->m_armed)
+        arm(false);
+}
+
+FramePacer::Stats FramePacer::stats()
+{
+    QMutexLocker locker(&this->m_mutex);
+    return this->m_stats;
+}
+
+void FramePacer::setPipelineStats(std::shared_ptr<PipelineStats> stats)
+{
+    QMutexLocker locker(&this->m_mutex);
+    this->m_pipelineStats = stats;
+}
+
+void FramePacer::arm(bool enable)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (enable) {
+        // First tick right away so the first frame isn't held back
+        spec.it_value.tv_nsec = 1;
+        spec.it_interval.tv_sec = this->m_fps == 1 ? 1 : 0;
+        spec.it_interval.tv_nsec = this->m_fps == 1 ? 0 : 1000000000L / this->m_fps;
+    }
+
+    if (timerfd_settime(this->m_timerFd, 0, &spec, nullptr) < 0) {
+        qWarning("Failed to arm pacing timerfd: %s", strerror(errno));
+        enable = false;
+    }
+    this->m_armed = enable;
+}
+
+void FramePacer::runTicks()
+{
+    for (;;) {
+        uint64_t expirations = 0;
+        if (read(this->m_timerFd, &expirations, sizeof(expirations)) < 0) {
+            if (errno == EINTR)
+                continue;
+            qWarning("Failed to read pacing timerfd: %s", strerror(errno));
+            return;
+        }
+
+        {
+            QMutexLocker locker(&this->m_mutex);
+            if (this->m_quit)
+                return;
+        }
+        tick(expirations);
+    }
+}
+
+void FramePacer::tick(uint64_t expirations)
+{
+    FrameRef frame;
+    {
+        QMutexLocker locker(&this->m_mutex);
+        if (!this->m_armed || this->m_pending.isNull())
+            return;
+
+        // A late tick still delivers only one frame, the cadence
+        // catches up instead of bursting
+        if (expirations > 1)
+            this->m_stats.missedTicks += expirations - 1;
+
+        if (!this->m_fresh) {
+            // Slow rates still repeat a frame before giving up
+            if (++this->m_idleTicks > std::max(1, this->m_fps * IDLE_TIMEOUT_MS / 1000)) {
+                this->m_pending.reset();
+                arm(false);
+                return;
+            }
+            ++this->m_stats.repeated;
+            if (this->m_pipelineStats)
+                ++this->m_pipelineStats->repeated;
+        }
+
+        frame = this->m_pending;
+        this->m_fresh = false;
+        ++this->m_stats.delivered;
+    }
+
+    emit frameDue(frame);
+}
+
+QDebug operator<<(QDebug debug, const FramePacer::Stats& stats)
+{
+    debug.nospace() << "FramePacer(delivered " << stats.delivered
+                    << ", dropped " << stats.dropped
+                    << ", repeated " << stats.repeated
+                    << ", missed ticks " << stats.missedTicks << ")";
+    return debug.space();
+}
@@ -0,0 +1,77 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+
+#include <memory>
+
+#include "framepool.h"
+#include "pipelinestats.h"
+
+// Hands frames on at a steady rate driven by a timerfd. The newest
+// frame submitted goes out on every tick: frames arriving faster than
+// the rate are dropped, missing ones are covered by repeating the last.
+// Pacing stops by itself once the source went quiet for a while and
+// restarts with the next frame. Ticks run on a thread of the pacer's
+// own, so paced frames never wait for the creating thread's event loop.
+class FramePacer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        quint64 delivered = 0;
+        quint64 dropped = 0;
+        quint64 repeated = 0;
+        quint64 missedTicks = 0;
+    };
+
+    explicit FramePacer(QObject *parent = nullptr);
+    ~FramePacer();
+
+    // 0 disables pacing, submitted frames then pass straight through
+    void setFrameRate(int fps);
+    int frameRate();
+
+    // From any thread
+    void submit(FrameRef frame);
+    // Forgets the pending frame and stops ticking until the next one
+    void reset();
+    // Ends the tick thread, frames pass straight through afterwards.
+    // Consumers of frameDue() call it before they go away.
+    void stop();
+
+    Stats stats();
+    // Drops and repeats are counted there as well
+    void setPipelineStats(std::shared_ptr<PipelineStats> stats);
+
+signals:
+    // Emitted on the tick thread, or the submitting one when disabled
+    void frameDue(FrameRef frame);
+
+private:
+    friend class FramePacerThread;
+
+    // Blocks on the timerfd until stop(), on m_thread
+    void runTicks();
+    void tick(uint64_t expirations);
+    void arm(bool enable);
+
+    int m_timerFd = -1;
+    QThread* m_thread = nullptr;
+    QMutex m_mutex;
+    int m_fps = 0;
+    bool m_armed = false;
+    bool m_quit = false;
+    FrameRef m_pending;
+    bool m_fresh = false;
+    int m_idleTicks = 0;
+    Stats m_stats;
+    std::shared_ptr<PipelineStats> m_pipelineStats;
+};
+
+QDebug operator<<(QDebug debug, const FramePacer::Stats& stats);
+
+#endif // FRAMEPACER_H
@@ -0,0 +1,232 @@
+#include "framepool.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+class FramePoolPrivate
+{
+public:
+    FramePoolPrivate(size_t bufferSize, size_t bufferCount, size_t alignment);
+    ~FramePoolPrivate();
+
+    FrameRef acquire();
+    void release(FrameBuffer* buffer);
+    void detach();
+    void unref();
+
+    size_t bufferSize;
+    std::vector<FrameBuffer> buffers;
+    std::vector<FrameBuffer*> freeBuffers;
+    mutable QMutex mutex;
+    FramePool::Stats stats;
+
+    // One reference for the owning FramePool plus one per buffer in use
+    std::atomic<int> outstanding;
+};
+
+FramePoolPrivate::FramePoolPrivate(size_t bufferSize, size_t bufferCount, size_t alignment) :
+    bufferSize(bufferSize),
+    buffers(bufferCount),
+    outstanding(1)
+{
+    this->freeBuffers.reserve(bufferCount);
+    for (FrameBuffer& buffer : this->buffers) {
+        void* data = nullptr;
+        if (posix_memalign(&data, alignment, bufferSize) != 0) {
+            qWarning("Failed to allocate %zu byte frame buffer", bufferSize);
+            continue;
+        }
+        memset(data, 0, bufferSize);
+
+        buffer.data = static_cast<uint8_t*>(data);
+        buffer.capacity = bufferSize;
+        buffer.bytesUsed = bufferSize;
+        buffer.refCount = 0;
+        buffer.pool = this;
+        this->freeBuffers.push_back(&buffer);
+    }
+    this->stats.buffers = this->freeBuffers.size();
+}
+
+FramePoolPrivate::~FramePoolPrivate()
+{
+    for (FrameBuffer& buffer : this->buffers)
+        free(buffer.data);
+}
+
+FrameRef FramePoolPrivate::acquire()
+{
+    QMutexLocker locker(&this->mutex);
+
+    if (this->freeBuffers.empty()) {
+        if (this->stats.exhausted++ == 0)
+            qWarning("Frame pool of %zu buffers exhausted", this->stats.buffers);
+        return FrameRef();
+    }
+
+    FrameBuffer* buffer = this->freeBuffers.back();
+    this->freeBuffers.pop_back();
+
+    ++this->stats.acquired;
+    ++this->stats.inUse;
+    if (this->stats.inUse > this->stats.highWaterMark)
+        this->stats.highWaterMark = this->stats.inUse;
+
+    buffer->bytesUsed = buffer->capacity;
+    buffer->timestamp = 0;
+    buffer->sequence = 0;
+    buffer->refCount = 1;
+    ++this->outstanding;
+    return FrameRef(buffer);
+}
+
+void FramePoolPrivate::release(FrameBuffer* buffer)
+{
+    {
+        QMutexLocker locker(&this->mutex);
+        this->freeBuffers.push_back(buffer);
+        --this->stats.inUse;
+    }
+    unref();
+}
+
+void FramePoolPrivate::detach()
+{
+    unref();
+}
+
+void FramePoolPrivate::unref()
+{
+    if (--this->outstanding == 0)
+        delete this;
+}
+
+FramePool::FramePool(size_t bufferSize, size_t bufferCount, size_t alignment) :
+    d(new FramePoolPrivate(bufferSize, bufferCount, alignment))
+{
+}
+
+FramePool::~FramePool()
+{
+    d->detach();
+}
+
+FrameRef FramePool::acquire()
+{
+    return d->acquire();
+}
+
+size_t FramePool::bufferSize() const
+{
+    return d->bufferSize;
+}
+
+FramePool::Stats FramePool::stats() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->stats;
+}
+
+FrameRef::FrameRef(const FrameRef& other) :
+    m_buffer(other.m_buffer)
+{
+    if (this->m_buffer)
+        ++this->m_buffer->refCount;
+}
+
+FrameRef::FrameRef(FrameRef&& other) :
+    m_buffer(other.m_buffer)
+{
+    other.m_buffer = nullptr;
+}
+
+FrameRef::~FrameRef()
+{
+    reset();
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other)
+{
+    if (other.m_buffer)
+        ++other.m_buffer->refCount;
+    reset();
+    this->m_buffer = other.m_buffer;
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other)
+{
+    if (this != &other) {
+        reset();
+        this->m_buffer = other.m_buffer;
+        other.m_buffer = nullptr;
+    }
+    return *this;
+}
+
+uint8_t* FrameRef::data() const
+{
+    return this->m_buffer ? this->m_buffer->data : nullptr;
+}
+
+size_t FrameRef::size() const
+{
+    return this->m_buffer ? this->m_buffer->bytesUsed : 0;
+}
+
+size_t FrameRef::capacity() const
+{
+    return this->m_buffer ? this->m_buffer->capacity : 0;
+}
+
+void FrameRef::setSize(size_t size)
+{
+    if (this->m_buffer)
+        this->m_buffer->bytesUsed = size < this->m_buffer->capacity ? size : this->m_buffer->capacity;
+}
+
+uint64_t FrameRef::timestamp() const
+{
+    return this->m_buffer ? this->m_buffer->timestamp : 0;
+}
+
+uint64_t FrameRef::sequence() const
+{
+    return this->m_buffer ? this->m_buffer->sequence : 0;
+}
+
+void FrameRef::setTiming(uint64_t timestamp, uint64_t sequence)
+{
+    if (this->m_buffer) {
+        this->m_buffer->timestamp = timestamp;
+        this->m_buffer->sequence = sequence;
+    }
+}
+
+void FrameRef::copyTiming(const FrameRef& source)
+{
+    setTiming(source.timestamp(), source.sequence());
+}
+
+void FrameRef::reset()
+{
+    FrameBuffer* buffer = this->m_buffer;
+    this->m_buffer = nullptr;
+
+    if (buffer && --buffer->refCount == 0)
+        buffer->pool->release(buffer);
+}
+
+QDebug operator<<(QDebug debug, const FramePool::Stats& stats)
+{
+    debug.nospace() << "FramePool(buffers " << stats.buffers
+                    << ", in use " << stats.inUse
+                    << ", high water " << stats.highWaterMark
+                    << ", acquired " << stats.acquired
+                    << ", exhausted " << stats.exhausted << ")";
+    return debug.space();
+}
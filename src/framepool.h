@@ -0,0 +1,95 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QDebug>
+#include <QMetaType>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class FramePoolPrivate;
+
+struct FrameBuffer {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+    size_t bytesUsed = 0;
+    // CLOCK_MONOTONIC capture time in nanoseconds and the source's frame
+    // counter, gaps in it are frames dropped on the way. 0 if unknown.
+    uint64_t timestamp = 0;
+    uint64_t sequence = 0;
+    std::atomic<int> refCount;
+    FramePoolPrivate* pool = nullptr;
+};
+
+// Shared handle on a pooled frame buffer.
+// The buffer goes back to its pool once the last handle is dropped,
+// copying a handle never copies pixel data.
+class FrameRef
+{
+public:
+    FrameRef() {}
+    FrameRef(const FrameRef& other);
+    FrameRef(FrameRef&& other);
+    ~FrameRef();
+
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef& operator=(FrameRef&& other);
+
+    bool isNull() const { return this->m_buffer == nullptr; }
+    uint8_t* data() const;
+    size_t size() const;
+    size_t capacity() const;
+    void setSize(size_t size);
+    uint64_t timestamp() const;
+    uint64_t sequence() const;
+    void setTiming(uint64_t timestamp, uint64_t sequence);
+    // Takes over the timing of the frame this one was made from
+    void copyTiming(const FrameRef& source);
+    void reset();
+
+private:
+    friend class FramePoolPrivate;
+    explicit FrameRef(FrameBuffer* buffer) : m_buffer(buffer) {}
+
+    FrameBuffer* m_buffer = nullptr;
+};
+Q_DECLARE_METATYPE(FrameRef)
+
+// Fixed set of aligned buffers handed out as FrameRefs.
+// acquire() never allocates, it returns a null FrameRef when all
+// buffers are in use. Buffers still referenced when the pool is
+// destroyed stay valid until their last FrameRef goes away.
+class FramePool
+{
+public:
+    struct Stats {
+        size_t buffers = 0;
+        size_t inUse = 0;
+        size_t highWaterMark = 0;
+        quint64 acquired = 0;
+        quint64 exhausted = 0;
+    };
+
+    static const size_t DEFAULT_BUFFER_COUNT = 4;
+    static const size_t DEFAULT_ALIGNMENT = 64;
+
+    explicit FramePool(size_t bufferSize,
+                       size_t bufferCount = DEFAULT_BUFFER_COUNT,
+                       size_t alignment = DEFAULT_ALIGNMENT);
+    ~FramePool();
+
+    FrameRef acquire();
+    size_t bufferSize() const;
+    Stats stats() const;
+
+private:
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    FramePoolPrivate* d;
+};
+
+QDebug operator<<(QDebug debug, const FramePool::Stats& stats);
+
+#endif // FRAMEPOOL_H
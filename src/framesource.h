@@ -0,0 +1,69 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <QObject>
+
+#include <memory>
+
+#include "framepool.h"
+#include "frametransform.h"
+#include "pipelinestats.h"
+#include "videoformat.h"
+
+// Common interface of everything that produces frames for a sink.
+// start() and stop() may be called from any thread, implementations
+// are expected to queue the actual work onto their own thread.
+class FrameSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameSource(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~FrameSource() {}
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
+
+    virtual size_t width() = 0;
+    virtual size_t height() = 0;
+    virtual PixelFormat pixelFormat() = 0;
+
+    VideoFormat format() { return VideoFormat(pixelFormat(), width(), height()); }
+
+    // Formats setFormat() accepts, sources that can't be reconfigured
+    // only offer what they produce
+    virtual QVector<VideoFormat> supportedFormats() { return { format() }; }
+    // Reconfigures the source to produce exactly the given format,
+    // from the thread the source was created on
+    virtual bool setFormat(const VideoFormat& format) { return format == this->format(); }
+
+    // Nominal frames per second, 0 if the source doesn't know
+    virtual int frameRate() { return 0; }
+    // Picks the closest rate the source can do, true if it is exact
+    virtual bool setFrameRate(int fps) { return fps == frameRate(); }
+
+    // Rotation, mirroring, crop and zoom of the frames produced, false
+    // if the source can't apply the transform
+    virtual bool setTransform(const FrameTransform& transform) { return transform == FrameTransform(); }
+
+    // Consumers opening and closing the device fed, for sources that
+    // keep running for a while after stop()
+    virtual void consumerOpened(const QString& consumer) {}
+    virtual void consumerClosed(const QString& consumer) {}
+
+    // Frames the sink may keep queued on top of the few every pipeline
+    // holds, sources size their frame pools for it. Call before start().
+    virtual void setQueueDepth(size_t frames) { this->m_queueDepth = frames; }
+
+    // Where stage timings and frame counts go, none by default
+    virtual void setStats(std::shared_ptr<PipelineStats> stats) { this->m_stats = stats; }
+
+signals:
+    void captured(FrameRef frame);
+
+protected:
+    std::shared_ptr<PipelineStats> m_stats;
+    size_t m_queueDepth = 0;
+};
+
+#endif // FRAMESOURCE_H
@@ -0,0 +1,87 @@
+#include "frametransform.h"
+
+bool FrameTransform::isValid() const
+{
+    return rotation % 90 == 0 && zoom >= 1.0f && zoom <= MAX_ZOOM;
+}
+
+FrameTransform FrameTransform::normalized() const
+{
+    FrameTransform transform = *this;
+    transform.rotation = ((rotation % 360) + 360) % 360;
+    return transform;
+}
+
+void frameTransformExtent(const FrameTransform& transform,
+                          size_t sourceWidth, size_t sourceHeight,
+                          size_t width, size_t height,
+                          float* extentX, float* extentY)
+{
+    const bool quarterTurn = transform.normalized().rotation % 180 == 90;
+
+    // Keep the rotated camera image's aspect ratio by showing less of
+    // its longer side
+    *extentX = 1.0f;
+    *extentY = 1.0f;
+    if (transform.crop && sourceWidth && sourceHeight && width && height) {
+        const float sourceAspect = quarterTurn ? (float)sourceHeight / sourceWidth
+                                               : (float)sourceWidth / sourceHeight;
+        const float aspect = (float)width / height;
+        if (sourceAspect > aspect)
+            *extentX = aspect / sourceAspect;
+        else
+            *extentY = sourceAspect / aspect;
+    }
+
+    *extentX /= transform.zoom;
+    *extentY /= transform.zoom;
+}
+
+void frameTransformMatrix(const FrameTransform& transform,
+                          size_t sourceWidth, size_t sourceHeight,
+                          size_t width, size_t height,
+                          float matrix[9])
+{
+    float extentX, extentY;
+    frameTransformExtent(transform, sourceWidth, sourceHeight, width, height, &extentX, &extentY);
+    if (transform.mirror)
+        extentX = -extentX;
+
+    // Output axes to camera axes around the centre. Turning the picture
+    // clockwise takes the camera's left column to the output's top row.
+    float r00 = 1.0f, r01 = 0.0f, r10 = 0.0f, r11 = 1.0f;
+    switch (transform.normalized().rotation) {
+    case 90:
+        r00 = 0.0f; r01 = 1.0f; r10 = -1.0f; r11 = 0.0f;
+        break;
+    case 180:
+        r00 = -1.0f; r11 = -1.0f;
+        break;
+    case 270:
+        r00 = 0.0f; r01 = -1.0f; r10 = 1.0f; r11 = 0.0f;
+        break;
+    default:
+        break;
+    }
+
+    const float a00 = r00 * extentX, a01 = r01 * extentY;
+    const float a10 = r10 * extentX, a11 = r11 * extentY;
+
+    // Centred on 0.5 on both sides
+    matrix[0] = a00;
+    matrix[1] = a10;
+    matrix[2] = 0.0f;
+    matrix[3] = a01;
+    matrix[4] = a11;
+    matrix[5] = 0.0f;
+    matrix[6] = 0.5f - 0.5f * (a00 + a01);
+    matrix[7] = 0.5f - 0.5f * (a10 + a11);
+    matrix[8] = 1.0f;
+}
+
+QDebug operator<<(QDebug debug, const FrameTransform& transform)
+{
+    debug.nospace() << "rotation " << transform.rotation << (transform.mirror ? " mirrored" : "")
+                    << (transform.crop ? " cropped" : "") << " zoom " << transform.zoom;
+    return debug.space();
+}
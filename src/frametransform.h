@@ -0,0 +1,51 @@
+#ifndef FRAMETRANSFORM_H
+#define FRAMETRANSFORM_H
+
+#include <QDebug>
+
+#include <cstddef>
+
+// Geometry applied to camera frames on the GPU, in the conversion pass
+// before readback, so consumers get frames ready to use
+struct FrameTransform {
+    static const int MAX_ZOOM = 8;
+
+    // Clockwise, a multiple of 90
+    int rotation = 0;
+    // Flips left and right, after rotating
+    bool mirror = false;
+    // Centre-crops the camera image to the output's aspect ratio
+    // instead of stretching it
+    bool crop = false;
+    // Magnifies around the centre, 1 to MAX_ZOOM
+    float zoom = 1.0f;
+
+    bool isValid() const;
+    // Same transform with rotation in [0, 360)
+    FrameTransform normalized() const;
+
+    bool operator==(const FrameTransform& other) const
+    {
+        return rotation == other.rotation && mirror == other.mirror && crop == other.crop && zoom == other.zoom;
+    }
+    bool operator!=(const FrameTransform& other) const { return !(*this == other); }
+};
+
+// Column-major 3x3 matrix taking output texture coordinates to camera
+// texture coordinates, both with the origin at the first pixel of the
+// frame. Sizes are in pixels, a source size of 0 disables cropping.
+void frameTransformMatrix(const FrameTransform& transform,
+                          size_t sourceWidth, size_t sourceHeight,
+                          size_t width, size_t height,
+                          float matrix[9]);
+
+// Fraction of the camera image's width and height, in output axes,
+// that ends up in the output
+void frameTransformExtent(const FrameTransform& transform,
+                          size_t sourceWidth, size_t sourceHeight,
+                          size_t width, size_t height,
+                          float* extentX, float* extentY);
+
+QDebug operator<<(QDebug debug, const FrameTransform& transform);
+
+#endif // FRAMETRANSFORM_H
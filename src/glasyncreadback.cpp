@@ -0,0 +1,184 @@
+#include "glasyncreadback.h"
+
+#include <QDebug>
+
+#include <cstring>
+#include <mutex>
+
+// How long collect() may block on a fence, in nanoseconds
+static const GLuint64 FENCE_TIMEOUT = 100 * 1000 * 1000;
+
+namespace {
+struct Gles3Functions {
+    PFNGLMAPBUFFERRANGEPROC mapBufferRange = nullptr;
+    PFNGLUNMAPBUFFERPROC unmapBuffer = nullptr;
+    PFNGLFENCESYNCPROC fenceSync = nullptr;
+    PFNGLCLIENTWAITSYNCPROC clientWaitSync = nullptr;
+    PFNGLDELETESYNCPROC deleteSync = nullptr;
+    std::once_flag resolved;
+
+    // Camera threads configure their readback concurrently, the table is
+    // filled by whichever comes first and only read afterwards
+    void resolve()
+    {
+        std::call_once(this->resolved, [this]() { resolveOnce(); });
+    }
+
+    void resolveOnce()
+    {
+        this->mapBufferRange = (PFNGLMAPBUFFERRANGEPROC)eglGetProcAddress("glMapBufferRange");
+        this->unmapBuffer = (PFNGLUNMAPBUFFERPROC)eglGetProcAddress("glUnmapBuffer");
+        this->fenceSync = (PFNGLFENCESYNCPROC)eglGetProcAddress("glFenceSync");
+        this->clientWaitSync = (PFNGLCLIENTWAITSYNCPROC)eglGetProcAddress("glClientWaitSync");
+        this->deleteSync = (PFNGLDELETESYNCPROC)eglGetProcAddress("glDeleteSync");
+    }
+
+    bool isComplete() const
+    {
+        return this->mapBufferRange && this->unmapBuffer && this->fenceSync &&
+               this->clientWaitSync && this->deleteSync;
+    }
+};
+}
+
+static Gles3Functions gles3;
+
+GlAsyncReadback::GlAsyncReadback()
+{
+}
+
+GlAsyncReadback::~GlAsyncReadback()
+{
+    release();
+}
+
+bool GlAsyncReadback::isSupported()
+{
+    if (glesMajorVersion() < 3)
+        return false;
+
+    gles3.resolve();
+    return gles3.isComplete();
+}
+
+void GlAsyncReadback::release()
+{
+    discard();
+
+    for (Slot& slot : this->m_slots) {
+        if (slot.buffer)
+            glDeleteBuffers(1, &slot.buffer);
+    }
+    this->m_slots.clear();
+}
+
+bool GlAsyncReadback::configure(GLsizei width, GLsizei height, size_t bufferCount)
+{
+    release();
+
+    if (!isSupported()) {
+        qInfo() << "Asynchronous readback needs GLES3";
+        return false;
+    }
+
+    this->m_width = width;
+    this->m_height = height;
+    this->m_slots.resize(bufferCount);
+    for (Slot& slot : this->m_slots) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bufferSize(), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    const GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        qWarning() << "Failed to set up pixel pack buffers:" << error;
+        release();
+        return false;
+    }
+
+    qInfo() << "Asynchronous readback with" << bufferCount << "pixel pack buffers of" << width << "x" << height;
+    return true;
+}
+
+bool GlAsyncReadback::isConfigured() const
+{
+    return !this->m_slots.empty();
+}
+
+bool GlAsyncReadback::queue(GLuint framebuffer)
+{
+    if (this->m_pending == this->m_slots.size())
+        return false;
+
+    Slot& slot = this->m_slots[(this->m_head + this->m_pending) % this->m_slots.size()];
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, this->m_width, this->m_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    slot.fence = gles3.fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    ++this->m_pending;
+    return true;
+}
+
+bool GlAsyncReadback::collect(void* destination, bool wait)
+{
+    if (this->m_pending == 0)
+        return false;
+
+    Slot& slot = this->m_slots[this->m_head];
+
+    if (slot.fence) {
+        const GLenum status = gles3.clientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                                   wait ? FENCE_TIMEOUT : 0);
+        if (status == GL_TIMEOUT_EXPIRED && !wait)
+            return false;
+        if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED)
+            qWarning() << "Readback fence wait failed:" << status;
+
+        gles3.deleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    bool success = true;
+    if (destination) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        void* mapped = gles3.mapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bufferSize(), GL_MAP_READ_BIT);
+        if (mapped) {
+            memcpy(destination, mapped, bufferSize());
+            gles3.unmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            qWarning() << "Failed to map pixel pack buffer:" << glGetError();
+            success = false;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    this->m_head = (this->m_head + 1) % this->m_slots.size();
+    --this->m_pending;
+    return success;
+}
+
+void GlAsyncReadback::discard()
+{
+    while (this->m_pending > 0)
+        collect(nullptr, true);
+    this->m_head = 0;
+}
+
+size_t GlAsyncReadback::pending() const
+{
+    return this->m_pending;
+}
+
+size_t GlAsyncReadback::bufferSize() const
+{
+    return (size_t)this->m_width * this->m_height * 4;
+}
@@ -0,0 +1,60 @@
+#ifndef GLASYNCREADBACK_H
+#define GLASYNCREADBACK_H
+
+#include <GLES3/gl3.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "eglhelper.h"
+
+// Ring of pixel pack buffers for reading back a framebuffer without
+// stalling on the GPU. queue() starts the copy of frame N into the
+// next buffer and fences it, collect() maps the oldest finished one
+// while later frames are still rendering. Needs a GLES3 context, the
+// entry points are resolved at runtime so GLES2-only drivers still load.
+// All methods need the owning GL context to be current.
+class GlAsyncReadback
+{
+public:
+    static const size_t DEFAULT_BUFFER_COUNT = 3;
+
+    GlAsyncReadback();
+    ~GlAsyncReadback();
+
+    static bool isSupported();
+
+    bool configure(GLsizei width, GLsizei height, size_t bufferCount = DEFAULT_BUFFER_COUNT);
+    bool isConfigured() const;
+
+    // Starts reading back the RGBA contents of the framebuffer.
+    // Returns false if all buffers are still waiting to be collected.
+    bool queue(GLuint framebuffer);
+
+    // Copies the oldest pending readback to destination, or just frees
+    // its buffer if destination is null. With wait false it only
+    // collects readbacks the GPU already finished.
+    bool collect(void* destination, bool wait);
+
+    // Drops all pending readbacks
+    void discard();
+
+    size_t pending() const;
+    size_t bufferSize() const;
+
+    void release();
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+    };
+
+    GLsizei m_width = 0;
+    GLsizei m_height = 0;
+    std::vector<Slot> m_slots;
+    size_t m_head = 0;
+    size_t m_pending = 0;
+};
+
+#endif // GLASYNCREADBACK_H
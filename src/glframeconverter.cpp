@@ -0,0 +1,320 @@
+#include "glframeconverter.h"
+
+#include <QByteArray>
+#include <QDebug>
+
+static const GLfloat QUAD_VERTICES[] = {
+    -1.0f, -1.0f,
+     1.0f, -1.0f,
+    -1.0f,  1.0f,
+     1.0f,  1.0f,
+};
+
+static const char* VERTEX_SHADER =
+    "attribute vec2 a_position;\n"
+    "varying vec2 v_texCoord;\n"
+    "void main() {\n"
+    "    v_texCoord = a_position * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(a_position, 0.0, 1.0);\n"
+    "}\n";
+
+// Shared prologue of all fragment shaders.
+// u_size is the output frame size in pixels, rgbAt() samples the camera
+// texture at the centre of a given output pixel coordinate. u_transform
+// rotates, mirrors, crops and zooms on the way from output to camera
+// coordinates. When scaling down, u_spread offsets four bilinear taps
+// around that centre so each output pixel averages its whole source
+// footprint instead of aliasing.
+// Colour conversion is BT.601 limited range.
+static const char* FRAGMENT_PROLOGUE =
+    "#extension GL_OES_EGL_image_external : require\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform samplerExternalOES u_texture;\n"
+    "uniform vec2 u_size;\n"
+    "uniform vec2 u_spread;\n"
+    "uniform mat3 u_transform;\n"
+    "varying vec2 v_texCoord;\n"
+    "vec3 sampleAt(vec2 pixel) {\n"
+    "    return texture2D(u_texture, (u_transform * vec3(pixel / u_size, 1.0)).xy).rgb;\n"
+    "}\n"
+    "vec3 rgbAt(vec2 pixel) {\n"
+    "    if (u_spread.x == 0.0 && u_spread.y == 0.0)\n"
+    "        return sampleAt(pixel);\n"
+    "    vec3 sum = sampleAt(pixel - u_spread);\n"
+    "    sum += sampleAt(pixel + u_spread);\n"
+    "    sum += sampleAt(pixel + vec2(u_spread.x, -u_spread.y));\n"
+    "    sum += sampleAt(pixel + vec2(-u_spread.x, u_spread.y));\n"
+    "    return sum * 0.25;\n"
+    "}\n"
+    "float luma(vec3 c) {\n"
+    "    return dot(c, vec3(0.256788, 0.504129, 0.097906)) + 0.062745;\n"
+    "}\n"
+    "float cb(vec3 c) {\n"
+    "    return dot(c, vec3(-0.148223, -0.290993, 0.439216)) + 0.501961;\n"
+    "}\n"
+    "float cr(vec3 c) {\n"
+    "    return dot(c, vec3(0.439216, -0.367788, -0.071427)) + 0.501961;\n"
+    "}\n";
+
+static const char* FRAGMENT_RGBA =
+    "void main() {\n"
+    "    gl_FragColor = vec4(rgbAt(gl_FragCoord.xy), 1.0);\n"
+    "}\n";
+
+// One texel holds Y0 U Y1 V of two horizontally adjacent pixels
+static const char* FRAGMENT_YUYV =
+    "void main() {\n"
+    "    float x = floor(gl_FragCoord.x) * 2.0;\n"
+    "    float y = gl_FragCoord.y;\n"
+    "    vec3 c0 = rgbAt(vec2(x + 0.5, y));\n"
+    "    vec3 c1 = rgbAt(vec2(x + 1.5, y));\n"
+    "    vec3 c = (c0 + c1) * 0.5;\n"
+    "    gl_FragColor = vec4(luma(c0), cb(c), luma(c1), cr(c));\n"
+    "}\n";
+
+// Rows [0, h) hold four luma samples per texel, followed by the chroma
+// plane(s). Chroma is sampled in the middle of each 2x2 block so linear
+// filtering averages the block.
+static const char* FRAGMENT_NV12 =
+    "void main() {\n"
+    "    float tx = floor(gl_FragCoord.x);\n"
+    "    float ty = floor(gl_FragCoord.y);\n"
+    "    if (ty < u_size.y) {\n"
+    "        float x = tx * 4.0;\n"
+    "        float y = ty + 0.5;\n"
+    "        gl_FragColor = vec4(luma(rgbAt(vec2(x + 0.5, y))), luma(rgbAt(vec2(x + 1.5, y))),\n"
+    "                            luma(rgbAt(vec2(x + 2.5, y))), luma(rgbAt(vec2(x + 3.5, y))));\n"
+    "    } else {\n"
+    "        float x = tx * 4.0;\n"
+    "        float y = (ty - u_size.y) * 2.0 + 1.0;\n"
+    "        vec3 c0 = rgbAt(vec2(x + 1.0, y));\n"
+    "        vec3 c1 = rgbAt(vec2(x + 3.0, y));\n"
+    "        gl_FragColor = vec4(cb(c0), cr(c0), cb(c1), cr(c1));\n"
+    "    }\n"
+    "}\n";
+
+// Like NV12, but each chroma texel row covers two half-width
+// chroma lines, U plane first, then V.
+static const char* FRAGMENT_I420 =
+    "float chroma(vec3 c, bool v) {\n"
+    "    return v ? cr(c) : cb(c);\n"
+    "}\n"
+    "void main() {\n"
+    "    float tx = floor(gl_FragCoord.x);\n"
+    "    float ty = floor(gl_FragCoord.y);\n"
+    "    if (ty < u_size.y) {\n"
+    "        float x = tx * 4.0;\n"
+    "        float y = ty + 0.5;\n"
+    "        gl_FragColor = vec4(luma(rgbAt(vec2(x + 0.5, y))), luma(rgbAt(vec2(x + 1.5, y))),\n"
+    "                            luma(rgbAt(vec2(x + 2.5, y))), luma(rgbAt(vec2(x + 3.5, y))));\n"
+    "    } else {\n"
+    "        float row = ty - u_size.y;\n"
+    "        float quarter = u_size.y / 4.0;\n"
+    "        bool v = row >= quarter;\n"
+    "        if (v)\n"
+    "            row -= quarter;\n"
+    "        float halfWidth = u_size.x / 2.0;\n"
+    "        float cx = tx * 4.0;\n"
+    "        float cy = row * 2.0;\n"
+    "        if (cx >= halfWidth) {\n"
+    "            cx -= halfWidth;\n"
+    "            cy += 1.0;\n"
+    "        }\n"
+    "        float x = cx * 2.0 + 1.0;\n"
+    "        float y = cy * 2.0 + 1.0;\n"
+    "        gl_FragColor = vec4(chroma(rgbAt(vec2(x, y)), v), chroma(rgbAt(vec2(x + 2.0, y)), v),\n"
+    "                            chroma(rgbAt(vec2(x + 4.0, y)), v), chroma(rgbAt(vec2(x + 6.0, y)), v));\n"
+    "    }\n"
+    "}\n";
+
+GlFrameConverter::GlFrameConverter()
+{
+}
+
+GlFrameConverter::~GlFrameConverter()
+{
+    release();
+}
+
+void GlFrameConverter::release()
+{
+    if (this->m_program)
+        glDeleteProgram(this->m_program);
+    if (this->m_fbo)
+        glDeleteFramebuffers(1, &this->m_fbo);
+    if (this->m_target)
+        glDeleteTextures(1, &this->m_target);
+
+    this->m_program = 0;
+    this->m_fbo = 0;
+    this->m_target = 0;
+}
+
+// Tap offset in output pixels along one axis. Bilinear filtering alone
+// covers up to 1.5 source texels per output pixel.
+static GLfloat tapSpread(size_t source, size_t output)
+{
+    return source * 2 > output * 3 ? 0.25f : 0.0f;
+}
+
+bool GlFrameConverter::configure(PixelFormat format, size_t width, size_t height,
+                                 size_t sourceWidth, size_t sourceHeight)
+{
+    if (!pixelFormatSupportsSize(format, width, height)) {
+        qWarning() << "Unsupported size for" << pixelFormatName(format) << width << height;
+        return false;
+    }
+
+    release();
+
+    const char* body = FRAGMENT_RGBA;
+    switch (format) {
+    case PixelFormat::Rgba32:
+        this->m_targetWidth = width;
+        this->m_targetHeight = height;
+        body = FRAGMENT_RGBA;
+        break;
+    case PixelFormat::Yuyv:
+        this->m_targetWidth = width / 2;
+        this->m_targetHeight = height;
+        body = FRAGMENT_YUYV;
+        break;
+    case PixelFormat::Nv12:
+        this->m_targetWidth = width / 4;
+        this->m_targetHeight = height * 3 / 2;
+        body = FRAGMENT_NV12;
+        break;
+    case PixelFormat::I420:
+        this->m_targetWidth = width / 4;
+        this->m_targetHeight = height * 3 / 2;
+        body = FRAGMENT_I420;
+        break;
+    default:
+        qDebug() << "No GPU conversion to" << pixelFormatName(format);
+        return false;
+    }
+
+    const QByteArray fragmentSource = QByteArray(FRAGMENT_PROLOGUE) + body;
+    this->m_program = provideProgram(VERTEX_SHADER, fragmentSource.constData());
+    if (!this->m_program)
+        return false;
+
+    this->m_positionAttribute = glGetAttribLocation(this->m_program, "a_position");
+    this->m_textureUniform = glGetUniformLocation(this->m_program, "u_texture");
+    this->m_sizeUniform = glGetUniformLocation(this->m_program, "u_size");
+    this->m_spreadUniform = glGetUniformLocation(this->m_program, "u_spread");
+    this->m_transformUniform = glGetUniformLocation(this->m_program, "u_transform");
+
+    provideRenderTarget(&this->m_target, this->m_targetWidth, this->m_targetHeight);
+    provideFramebuffer(&this->m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->m_target, 0);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        qWarning() << "Incomplete conversion framebuffer:" << status;
+        release();
+        return false;
+    }
+
+    this->m_format = format;
+    this->m_width = width;
+    this->m_height = height;
+    this->m_sourceWidth = sourceWidth;
+    this->m_sourceHeight = sourceHeight;
+    updateTransform();
+
+    qInfo() << "GPU conversion to" << pixelFormatName(format) << width << height
+            << "via" << this->m_targetWidth << "x" << this->m_targetHeight << "target";
+    if (sourceWidth && sourceHeight && (sourceWidth != width || sourceHeight != height))
+        qInfo() << "Scaling from" << sourceWidth << sourceHeight;
+    return true;
+}
+
+void GlFrameConverter::setTransform(const FrameTransform& transform)
+{
+    this->m_transform = transform.normalized();
+    updateTransform();
+}
+
+FrameTransform GlFrameConverter::transform() const
+{
+    return this->m_transform;
+}
+
+void GlFrameConverter::updateTransform()
+{
+    frameTransformMatrix(this->m_transform, this->m_sourceWidth, this->m_sourceHeight,
+                         this->m_width, this->m_height, this->m_transformMatrix);
+
+    // Only the part of the camera image that is shown gets scaled down,
+    // along the output axis it ends up on
+    float extentX, extentY;
+    frameTransformExtent(this->m_transform, this->m_sourceWidth, this->m_sourceHeight,
+                         this->m_width, this->m_height, &extentX, &extentY);
+    const bool quarterTurn = this->m_transform.rotation % 180 == 90;
+    const size_t shownWidth = (quarterTurn ? this->m_sourceHeight : this->m_sourceWidth) * extentX;
+    const size_t shownHeight = (quarterTurn ? this->m_sourceWidth : this->m_sourceHeight) * extentY;
+    this->m_spreadX = shownWidth ? tapSpread(shownWidth, this->m_width) : 0.0f;
+    this->m_spreadY = shownHeight ? tapSpread(shownHeight, this->m_height) : 0.0f;
+}
+
+void GlFrameConverter::render(GLuint externalTexture)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, this->m_fbo);
+    glViewport(0, 0, this->m_targetWidth, this->m_targetHeight);
+
+    glUseProgram(this->m_program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, externalTexture);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glUniform1i(this->m_textureUniform, 0);
+    glUniform2f(this->m_sizeUniform, this->m_width, this->m_height);
+    glUniform2f(this->m_spreadUniform, this->m_spreadX, this->m_spreadY);
+    glUniformMatrix3fv(this->m_transformUniform, 1, GL_FALSE, this->m_transformMatrix);
+
+    glVertexAttribPointer(this->m_positionAttribute, 2, GL_FLOAT, GL_FALSE, 0, QUAD_VERTICES);
+    glEnableVertexAttribArray(this->m_positionAttribute);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(this->m_positionAttribute);
+
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+    glUseProgram(0);
+}
+
+void GlFrameConverter::readPixels(void* destination)
+{
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, this->m_targetWidth, this->m_targetHeight, GL_RGBA, GL_UNSIGNED_BYTE, destination);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+PixelFormat GlFrameConverter::format() const
+{
+    return this->m_format;
+}
+
+GLuint GlFrameConverter::framebuffer() const
+{
+    return this->m_fbo;
+}
+
+size_t GlFrameConverter::frameSize() const
+{
+    return pixelFormatFrameSize(this->m_format, this->m_width, this->m_height);
+}
+
+GLsizei GlFrameConverter::targetWidth() const
+{
+    return this->m_targetWidth;
+}
+
+GLsizei GlFrameConverter::targetHeight() const
+{
+    return this->m_targetHeight;
+}
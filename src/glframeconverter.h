@@ -0,0 +1,63 @@
+#ifndef GLFRAMECONVERTER_H
+#define GLFRAMECONVERTER_H
+
+#include "eglhelper.h"
+#include "frametransform.h"
+#include "videoformat.h"
+
+// Renders an external (camera) texture into a render target laid out
+// byte for byte like a frame of the requested pixel format, so a plain
+// RGBA readback of the target yields the packed frame.
+// All methods need the owning GL context to be current.
+class GlFrameConverter
+{
+public:
+    GlFrameConverter();
+    ~GlFrameConverter();
+
+    // The camera texture is scaled to width x height, sourceWidth and
+    // sourceHeight are its size if known, to filter when scaling down
+    bool configure(PixelFormat format, size_t width, size_t height,
+                   size_t sourceWidth = 0, size_t sourceHeight = 0);
+    // Applied from the next render on, kept across configure(). Needs
+    // no GL context.
+    void setTransform(const FrameTransform& transform);
+    FrameTransform transform() const;
+    void render(GLuint externalTexture);
+    void readPixels(void* destination);
+
+    PixelFormat format() const;
+    GLuint framebuffer() const;
+    size_t frameSize() const;
+
+    // Size of the packed render target in RGBA texels
+    GLsizei targetWidth() const;
+    GLsizei targetHeight() const;
+
+    void release();
+
+private:
+    PixelFormat m_format = PixelFormat::Rgba32;
+    size_t m_width = 0;
+    size_t m_height = 0;
+    GLsizei m_targetWidth = 0;
+    GLsizei m_targetHeight = 0;
+    GLuint m_program = 0;
+    GLuint m_fbo = 0;
+    GLuint m_target = 0;
+    GLint m_positionAttribute = -1;
+    GLint m_textureUniform = -1;
+    GLint m_sizeUniform = -1;
+    GLint m_spreadUniform = -1;
+    GLint m_transformUniform = -1;
+    GLfloat m_spreadX = 0.0f;
+    GLfloat m_spreadY = 0.0f;
+    size_t m_sourceWidth = 0;
+    size_t m_sourceHeight = 0;
+    FrameTransform m_transform;
+    GLfloat m_transformMatrix[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+    void updateTransform();
+};
+
+#endif // GLFRAMECONVERTER_H
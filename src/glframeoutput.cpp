@@ -0,0 +1,199 @@
+#include "glframeoutput.h"
+
+#include <QDebug>
+
+#include "pixelconvert.h"
+
+// Frames in flight on the GPU before one is collected with async readback
+static const size_t READBACK_LAG = 1;
+
+bool GlFrameOutput::configure(const VideoFormat& format, size_t captureWidth, size_t captureHeight)
+{
+    // The readback ring is sized for the old target, it is set up again
+    // with the next frame
+    this->m_readback.release();
+    this->m_readbackTimings.clear();
+    this->m_readbackTimings.reserve(GlAsyncReadback::DEFAULT_BUFFER_COUNT);
+    this->m_format = format;
+
+    // Convert on the GPU so only the packed target format is read back,
+    // formats the shaders don't produce are converted from RGBA on the CPU
+    this->m_cpuConversion = false;
+    bool success = true;
+    if (!this->m_converter.configure(format.pixelFormat, format.width, format.height,
+                                     captureWidth, captureHeight)) {
+        this->m_converter.configure(PixelFormat::Rgba32, format.width, format.height,
+                                    captureWidth, captureHeight);
+
+        if (pixelConvertSupports(PixelFormat::Rgba32, format.pixelFormat)) {
+            qInfo() << "Converting to" << pixelFormatName(format.pixelFormat) << "on the CPU";
+            this->m_cpuConversion = true;
+            this->m_rgbaFrame.resize(this->m_converter.frameSize());
+        } else {
+            qWarning() << "Falling back to RGBA output";
+            success = false;
+        }
+    }
+
+    const size_t frameSize = this->m_cpuConversion
+            ? format.frameSize()
+            : this->m_converter.frameSize();
+    this->m_framePool.reset(new FramePool(frameSize, FramePool::DEFAULT_BUFFER_COUNT + this->m_queueDepth));
+    return success;
+}
+
+bool GlFrameOutput::isConfigured() const
+{
+    return this->m_framePool != nullptr;
+}
+
+void GlFrameOutput::setAsyncReadback(bool enabled)
+{
+    this->m_asyncReadback = enabled;
+}
+
+void GlFrameOutput::setTransform(const FrameTransform& transform)
+{
+    this->m_converter.setTransform(transform);
+}
+
+void GlFrameOutput::setQueueDepth(size_t frames)
+{
+    this->m_queueDepth = frames;
+    if (this->m_framePool) {
+        this->m_framePool.reset(new FramePool(this->m_framePool->bufferSize(),
+                                              FramePool::DEFAULT_BUFFER_COUNT + frames));
+    }
+}
+
+void GlFrameOutput::render(GLuint texture, uint64_t timestamp, uint64_t sequence,
+                           const std::shared_ptr<PipelineStats>& stats,
+                           std::vector<FrameRef>* frames)
+{
+    if (!this->m_framePool)
+        return;
+
+    if (this->m_asyncReadback && !this->m_readback.isConfigured()) {
+        this->m_asyncReadback = this->m_readback.configure(this->m_converter.targetWidth(),
+                                                           this->m_converter.targetHeight());
+    }
+
+    if (this->m_asyncReadback) {
+        renderAsync(texture, timestamp, sequence, stats, frames);
+        return;
+    }
+
+    // Drop the frame if all buffers are still held downstream
+    FrameRef frame = this->m_framePool->acquire();
+    if (frame.isNull()) {
+        if (stats)
+            ++stats->dropped;
+        return;
+    }
+
+    this->m_converter.render(texture);
+    {
+        StageTimer timer(stats, PipelineStats::ReadPixels);
+        this->m_converter.readPixels(readbackTarget(frame));
+    }
+    completeFrame(frame);
+    frame.setTiming(timestamp, sequence);
+
+    if (stats)
+        ++stats->produced;
+    frames->push_back(frame);
+}
+
+void GlFrameOutput::renderAsync(GLuint texture, uint64_t timestamp, uint64_t sequence,
+                                const std::shared_ptr<PipelineStats>& stats,
+                                std::vector<FrameRef>* frames)
+{
+    // Frames left over from before the last stop are stale
+    if (this->m_discardReadback.exchange(false)) {
+        this->m_readback.discard();
+        this->m_readbackTimings.clear();
+    }
+
+    this->m_converter.render(texture);
+    if (!this->m_readback.queue(this->m_converter.framebuffer())) {
+        qWarning() << "Readback ring full, dropping frame";
+        if (stats)
+            ++stats->dropped;
+        return;
+    }
+    this->m_readbackTimings.push_back({ timestamp, sequence });
+
+    // Hand out earlier frames while the one just queued is in flight
+    while (this->m_readback.pending() > READBACK_LAG) {
+        FrameRef frame = this->m_framePool->acquire();
+        bool collected;
+        {
+            StageTimer timer(stats, PipelineStats::ReadPixels);
+            collected = this->m_readback.collect(frame.isNull() ? nullptr : readbackTarget(frame), true);
+        }
+        const Timing timing = this->m_readbackTimings.front();
+        this->m_readbackTimings.erase(this->m_readbackTimings.begin());
+        // A buffer that failed to map holds whatever it held before
+        if (frame.isNull() || !collected) {
+            frame.reset();
+            if (stats)
+                ++stats->dropped;
+            continue;
+        }
+
+        completeFrame(frame);
+        frame.setTiming(timing.timestamp, timing.sequence);
+        if (stats)
+            ++stats->produced;
+        frames->push_back(frame);
+    }
+}
+
+void GlFrameOutput::discardPending()
+{
+    this->m_discardReadback = true;
+}
+
+uint8_t* GlFrameOutput::readbackTarget(FrameRef& frame)
+{
+    return this->m_cpuConversion ? this->m_rgbaFrame.data() : frame.data();
+}
+
+void GlFrameOutput::completeFrame(FrameRef& frame)
+{
+    if (!this->m_cpuConversion) {
+        frame.setSize(this->m_converter.frameSize());
+        return;
+    }
+
+    pixelConvert(this->m_rgbaFrame.data(), PixelFormat::Rgba32, frame.data(), this->m_format.pixelFormat,
+                 this->m_format.width, this->m_format.height);
+    frame.setSize(this->m_format.frameSize());
+}
+
+VideoFormat GlFrameOutput::format() const
+{
+    return this->m_format;
+}
+
+PixelFormat GlFrameOutput::pixelFormat() const
+{
+    if (this->m_cpuConversion)
+        return this->m_format.pixelFormat;
+
+    return this->m_framePool ? this->m_converter.format() : this->m_format.pixelFormat;
+}
+
+FramePool::Stats GlFrameOutput::poolStats() const
+{
+    return this->m_framePool ? this->m_framePool->stats() : FramePool::Stats();
+}
+
+void GlFrameOutput::release()
+{
+    this->m_framePool.reset();
+    this->m_readback.release();
+    this->m_readbackTimings.clear();
+    this->m_converter.release();
+    this->m_rgbaFrame.clear();
+}
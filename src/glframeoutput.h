@@ -0,0 +1,79 @@
+#ifndef GLFRAMEOUTPUT_H
+#define GLFRAMEOUTPUT_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "eglhelper.h"
+#include "framepool.h"
+#include "glasyncreadback.h"
+#include "glframeconverter.h"
+#include "pipelinestats.h"
+#include "videoformat.h"
+
+// One format and size made from the camera texture: a conversion pass
+// on the GPU, read back synchronously or through a pixel pack buffer
+// ring, into pooled frames. Formats the shaders don't produce are
+// converted from RGBA on the CPU.
+// All methods but the getters and discardPending() need the owning GL
+// context to be current.
+class GlFrameOutput
+{
+public:
+    // False if frames fall back to RGBA at the requested size
+    bool configure(const VideoFormat& format, size_t captureWidth, size_t captureHeight);
+    bool isConfigured() const;
+
+    void setAsyncReadback(bool enabled);
+    // Frames the sink may keep queued, the pool grows by as many. Needs
+    // no GL context, the pool is replaced right away.
+    void setQueueDepth(size_t frames);
+    // Geometry of the frames rendered from now on, needs no GL context
+    void setTransform(const FrameTransform& transform);
+
+    // Renders the texture and appends the frames finished meanwhile,
+    // which lag behind by a frame with async readback. Frames carry the
+    // timing of the texture update they were rendered from.
+    void render(GLuint texture, uint64_t timestamp, uint64_t sequence,
+                const std::shared_ptr<PipelineStats>& stats,
+                std::vector<FrameRef>* frames);
+
+    // Pending readbacks are dropped before the next render, from any thread
+    void discardPending();
+
+    // Format last configured
+    VideoFormat format() const;
+    // Format of the frames handed out, RGBA if the requested one failed
+    PixelFormat pixelFormat() const;
+    FramePool::Stats poolStats() const;
+
+    void release();
+
+private:
+    struct Timing {
+        uint64_t timestamp;
+        uint64_t sequence;
+    };
+
+    void renderAsync(GLuint texture, uint64_t timestamp, uint64_t sequence,
+                     const std::shared_ptr<PipelineStats>& stats,
+                     std::vector<FrameRef>* frames);
+    uint8_t* readbackTarget(FrameRef& frame);
+    void completeFrame(FrameRef& frame);
+
+    VideoFormat m_format;
+    GlFrameConverter m_converter;
+    GlAsyncReadback m_readback;
+    // Timing of every pending readback, oldest first
+    std::vector<Timing> m_readbackTimings;
+    bool m_asyncReadback = true;
+    std::atomic<bool> m_discardReadback { false };
+    // RGBA readback for formats converted on the CPU
+    bool m_cpuConversion = false;
+    std::vector<uint8_t> m_rgbaFrame;
+    std::unique_ptr<FramePool> m_framePool;
+    size_t m_queueDepth = 0;
+};
+
+#endif // GLFRAMEOUTPUT_H
@@ -2,6 +2,12 @@
 
 #include <QMutexLocker>
 #include <QMetaObject>
+#include <QThread>
+
+#include <algorithm>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 // Default camera names, assumes a max of 2 right now
 const QString DESCRIPTION_FRONT = QStringLiteral("Front-facing camera");
@@ -9,6 +15,11 @@ const QString DESCRIPTION_BACK = QStringLiteral("Back-facing camera");
 
 const int ANDROID_OK = 0;
 
+// Output size unless asked otherwise, the camera still captures at its
+// largest preview size and the GPU scales down
+static const size_t DEFAULT_OUTPUT_WIDTH = 1280;
+static const size_t DEFAULT_OUTPUT_HEIGHT = 720;
+
 QVector<HybrisCameraInfo> HybrisCameraSource::availableCameras()
 {
     QVector<HybrisCameraInfo> ret;
@@ -43,36 +54,50 @@ QVector<HybrisCameraInfo> HybrisCameraSource::availableCameras()
     return ret;
 }
 
-static void removeAlpha(uint8_t* from, uint8_t* to, size_t fromLength)
-{
-    size_t toLength = 0;
-    for (int i = 0; i < fromLength; i++) {
-        if (i % 4 == 3) continue;
-        to[toLength++] = from[i];
-    }
-}
-
 static void readTextureIntoBuffer(void* ctx)
 {
     HybrisCameraSource* thiz = static_cast<HybrisCameraSource*>(ctx);
 
-    QMetaObject::invokeMethod(thiz, "requestFrame", Qt::QueuedConnection);
+    thiz->notifyFrameAvailable();
 }
 
 static void setPreviewSize(void* ctx, int width, int height)
 {
     HybrisCameraSource* thiz = static_cast<HybrisCameraSource*>(ctx);
 
-    thiz->setSize(width, height);
+    thiz->addPreviewSize(width, height);
 }
 
-HybrisCameraSource::HybrisCameraSource(HybrisCameraInfo info, EGLContext context,
-                                       EGLDisplay display, EGLSurface surface, QObject *parent) :
-    QObject(parent),
+// Largest size of the capture's aspect ratio within the default output
+// size, aligned for every output format (MJPEG needs the most, whole
+// 16 pixel wide MCUs, see pixelFormatSupportsSize())
+static void fitOutputSize(size_t captureWidth, size_t captureHeight, size_t* width, size_t* height)
+{
+    *width = captureWidth;
+    *height = captureHeight;
+    if (captureWidth > DEFAULT_OUTPUT_WIDTH || captureHeight > DEFAULT_OUTPUT_HEIGHT) {
+        if (captureWidth * DEFAULT_OUTPUT_HEIGHT > captureHeight * DEFAULT_OUTPUT_WIDTH) {
+            *width = DEFAULT_OUTPUT_WIDTH;
+            *height = captureHeight * DEFAULT_OUTPUT_WIDTH / captureWidth;
+        } else {
+            *width = captureWidth * DEFAULT_OUTPUT_HEIGHT / captureHeight;
+            *height = DEFAULT_OUTPUT_HEIGHT;
+        }
+    }
+
+    *width -= *width % 16;
+    *height -= *height % 4;
+}
+
+HybrisCameraSource::HybrisCameraSource(HybrisCameraInfo info, EGLContext sharedContext,
+                                       EGLDisplay display, PixelFormat format, QObject *parent) :
+    FrameSource(parent),
     m_listener(new CameraControlListener),
-    m_eglContext(context),
+    m_format(format),
+    m_sharedContext(sharedContext),
     m_eglDisplay(display),
-    m_eglSurface(surface)
+    m_thread(new QThread),
+    m_stopDelayer(this)
 {
     if (info.id < 0)
         return;
@@ -91,44 +116,66 @@ HybrisCameraSource::HybrisCameraSource(HybrisCameraInfo info, EGLContext context
     // Applications tend to query the device and only see it as valid when
     // it receives frames from the V4L2 device.
     // To have repeated accesses not be disturbed, just delay stopping of the
-    // actual feed.
+    // actual feed, by as much as the closing consumer needed to come back
+    // before.
     this->m_stopDelayer.setSingleShot(true);
-    this->m_stopDelayer.setInterval(3000);
+    this->m_stopDelayer.setInterval(StopDelayPolicy::DEFAULT_DELAY_MS);
     QObject::connect(&this->m_stopDelayer, &QTimer::timeout,
                      this, [=](){
+        if (!this->m_control)
+            return;
         qDebug() << "... stopping camera now!";
         android_camera_stop_preview(this->m_control);
+        qInfo() << this->m_output.poolStats() << "skipped callbacks:" << this->m_skippedFrames;
     });
 
     android_camera_enumerate_supported_preview_sizes(this->m_control, &setPreviewSize, this);
-    android_camera_set_preview_size(this->m_control, this->width(), this->height());
+    android_camera_set_preview_size(this->m_control, this->m_captureWidth, this->m_captureHeight);
+    fitOutputSize(this->m_captureWidth, this->m_captureHeight, &this->m_width, &this->m_height);
+    qInfo() << "Capturing at" << this->m_captureWidth << this->m_captureHeight;
     android_camera_set_rotation(this->m_control, info.orientation);
 
-    this->m_pixelBuffer.resize(this->width() * this->height() * 4);
-
-    int min, max;
+    // The HAL reports the range scaled by 1000
+    int min = 0, max = 0;
     android_camera_get_preview_fps_range(this->m_control, &min, &max);
-    android_camera_set_preview_fps(this->m_control, min);
+    this->m_minFps = min >= 1000 ? min / 1000 : min;
+    this->m_maxFps = max >= 1000 ? max / 1000 : max;
+    if (this->m_maxFps < this->m_minFps)
+        this->m_maxFps = this->m_minFps;
+    qInfo() << "Preview fps range" << this->m_minFps << this->m_maxFps;
+    setFrameRate(this->m_maxFps);
     android_camera_set_preview_callback_mode(this->m_control, PREVIEW_CALLBACK_ENABLED);
 
     android_camera_set_preview_format(this->m_control, CAMERA_PIXEL_FORMAT_RGBA8888);
-    provideExternalTexture(&this->m_texture);
-    provideFramebuffer(&this->m_fbo);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, this->m_fbo);
-    glBindTexture(GL_TEXTURE_EXTERNAL_OES, this->m_texture);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_EXTERNAL_OES, this->m_texture, 0);
-
-    android_camera_set_preview_texture(this->m_control, this->m_texture);
+    // Everything from here on, including all frame callbacks, runs on the
+    // camera's own thread with its own context, so cameras don't serialize
+    // each other or the main loop.
+    this->m_thread->setObjectName(QStringLiteral("camera%1").arg(info.id));
+    this->moveToThread(this->m_thread);
+    this->m_thread->start();
+    QMetaObject::invokeMethod(this, "initializeGl", Qt::BlockingQueuedConnection);
 }
 
 HybrisCameraSource::~HybrisCameraSource()
 {
-    if (this->m_control) {
-        android_camera_disconnect(this->m_control);
-        android_camera_delete(this->m_control);
-        this->m_control = nullptr;
+    // Frames already queued on the camera thread must not render anymore
+    this->m_active = false;
+    for (const auto& output : this->m_outputs) {
+        output->m_active = false;
+        output->m_camera = nullptr;
+    }
+
+    // The camera thread disconnects from the HAL itself, nothing it still
+    // has queued can reach the handle afterwards
+    if (this->m_thread->isRunning()) {
+        QMetaObject::invokeMethod(this, "releaseGl", Qt::BlockingQueuedConnection);
+        this->m_thread->quit();
+        this->m_thread->wait();
     }
+    disconnectCamera();
+    delete this->m_thread;
+    this->m_thread = nullptr;
 
     if (this->m_listener) {
         delete this->m_listener;
@@ -136,17 +183,200 @@ HybrisCameraSource::~HybrisCameraSource()
     }
 }
 
-void HybrisCameraSource::setSize(const size_t &width, const size_t &height)
+void HybrisCameraSource::initializeGl()
 {
-    // Don't support anything higher than 720p for now
-    if (width > 1280 || height > 720)
+    if (!createSharedEglContext(this->m_eglDisplay, this->m_sharedContext,
+                                &this->m_eglContext, &this->m_eglSurface)) {
+        qWarning() << "Failed to create context for camera thread";
         return;
+    }
 
-    if (width <= this->m_width && height <= this->m_height)
+    // Made current once, the context stays bound to this thread
+    const bool mcSuccess = eglMakeCurrent(this->m_eglDisplay, this->m_eglSurface, this->m_eglSurface, this->m_eglContext);
+    if (!mcSuccess) {
+        qWarning() << "Failed to make current" << eglGetError();
         return;
+    }
+
+    provideExternalTexture(&this->m_texture);
 
-    this->m_width = width;
-    this->m_height = height;
+    // A pass hands out at most every pending readback at once
+    this->m_renderedFrames.reserve(GlAsyncReadback::DEFAULT_BUFFER_COUNT);
+
+    this->m_frameEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->m_frameEventFd < 0) {
+        qWarning("Failed to create frame eventfd: %s", strerror(errno));
+        return;
+    }
+    this->m_frameNotifier = new QSocketNotifier(this->m_frameEventFd, QSocketNotifier::Read, this);
+    QObject::connect(this->m_frameNotifier, &QSocketNotifier::activated,
+                     this, &HybrisCameraSource::handleFrameAvailable);
+
+    configureOutput();
+
+    android_camera_set_preview_texture(this->m_control, this->m_texture);
+}
+
+void HybrisCameraSource::configureOutput()
+{
+    QMutexLocker locker(&this->m_bufferMutex);
+
+    // Only outputs whose format changed start over
+    const VideoFormat format(this->m_format, this->width(), this->height());
+    if (!this->m_output.isConfigured() || this->m_output.format() != format)
+        this->m_output.configure(format, this->m_captureWidth, this->m_captureHeight);
+
+    for (const auto& output : this->m_outputs) {
+        if (!output->m_output.isConfigured() || output->m_output.format() != output->m_format)
+            output->m_output.configure(output->m_format, this->m_captureWidth, this->m_captureHeight);
+    }
+}
+
+void HybrisCameraSource::disconnectCamera()
+{
+    if (!this->m_control)
+        return;
+
+    android_camera_disconnect(this->m_control);
+    android_camera_delete(this->m_control);
+    this->m_control = nullptr;
+}
+
+void HybrisCameraSource::releaseGl()
+{
+    // No more frame callbacks or delayed stops once the HAL is gone
+    this->m_stopDelayer.stop();
+    disconnectCamera();
+
+    QMutexLocker locker(&this->m_bufferMutex);
+
+    this->m_output.release();
+    for (const auto& output : this->m_outputs)
+        output->m_output.release();
+
+    if (this->m_frameNotifier) {
+        delete this->m_frameNotifier;
+        this->m_frameNotifier = nullptr;
+    }
+    if (this->m_frameEventFd >= 0) {
+        close(this->m_frameEventFd);
+        this->m_frameEventFd = -1;
+    }
+
+    if (this->m_texture) {
+        glDeleteTextures(1, &this->m_texture);
+        this->m_texture = 0;
+    }
+
+    destroyEglContext(this->m_eglDisplay, this->m_eglContext, this->m_eglSurface);
+    this->m_eglContext = EGL_NO_CONTEXT;
+    this->m_eglSurface = EGL_NO_SURFACE;
+}
+
+void HybrisCameraSource::addPreviewSize(const size_t &width, const size_t &height)
+{
+    if (width * height <= this->m_captureWidth * this->m_captureHeight)
+        return;
+
+    this->m_captureWidth = width;
+    this->m_captureHeight = height;
+}
+
+bool HybrisCameraSource::setOutputSize(size_t width, size_t height)
+{
+    if (!pixelFormatSupportsSize(this->m_format, width, height)) {
+        qWarning() << "Unsupported output size" << width << height;
+        return false;
+    }
+
+    if (width == this->m_width && height == this->m_height)
+        return true;
+
+    {
+        // Read by the camera thread when it configures the output
+        QMutexLocker locker(&this->m_bufferMutex);
+        this->m_width = width;
+        this->m_height = height;
+    }
+    qInfo() << "Output size" << width << height;
+
+    reconfigure();
+    return true;
+}
+
+QVector<VideoFormat> HybrisCameraSource::supportedFormats()
+{
+    // Formats the shaders produce, then those converted on the CPU
+    static const QVector<PixelFormat> pixelFormats = {
+        PixelFormat::Rgba32,
+        PixelFormat::Yuyv,
+        PixelFormat::Nv12,
+        PixelFormat::I420,
+        PixelFormat::Rgb24,
+        PixelFormat::Bgr24,
+    };
+
+    return videoFormatLadder(pixelFormats, this->m_captureWidth, this->m_captureHeight);
+}
+
+bool HybrisCameraSource::setFormat(const VideoFormat& format)
+{
+    if (format == this->format())
+        return true;
+    if (!supportedFormats().contains(format))
+        return false;
+
+    {
+        QMutexLocker locker(&this->m_bufferMutex);
+        this->m_format = format.pixelFormat;
+        this->m_width = format.width;
+        this->m_height = format.height;
+    }
+    qInfo() << "Switching to" << format;
+
+    reconfigure();
+    return true;
+}
+
+int HybrisCameraSource::frameRate()
+{
+    return this->m_fps;
+}
+
+bool HybrisCameraSource::setFrameRate(int fps)
+{
+    if (!this->m_control || fps <= 0)
+        return false;
+
+    const int closest = std::max(this->m_minFps, std::min(fps, this->m_maxFps));
+    if (closest != this->m_fps) {
+        android_camera_set_preview_fps(this->m_control, closest);
+        this->m_fps = closest;
+        qInfo() << "Preview at" << closest << "fps";
+    }
+    return closest == fps;
+}
+
+void HybrisCameraSource::reconfigure()
+{
+    // Rebuild the conversion on the camera thread once GL is up
+    if (this->m_eglContext == EGL_NO_CONTEXT)
+        return;
+
+    if (QThread::currentThread() == this->m_thread)
+        configureOutput();
+    else
+        QMetaObject::invokeMethod(this, "configureOutput", Qt::BlockingQueuedConnection);
+}
+
+size_t HybrisCameraSource::captureWidth()
+{
+    return this->m_captureWidth;
+}
+
+size_t HybrisCameraSource::captureHeight()
+{
+    return this->m_captureHeight;
 }
 
 size_t HybrisCameraSource::width()
@@ -159,6 +389,13 @@ size_t HybrisCameraSource::height()
     return this->m_height;
 }
 
+PixelFormat HybrisCameraSource::pixelFormat()
+{
+    QMutexLocker locker(&this->m_bufferMutex);
+
+    return this->m_output.isConfigured() ? this->m_output.pixelFormat() : this->m_format;
+}
+
 QMutex* HybrisCameraSource::bufferMutex()
 {
     return &this->m_bufferMutex;
@@ -169,6 +406,21 @@ void HybrisCameraSource::start()
     if (!this->m_control)
         return;
 
+    {
+        // The camera thread configures and releases the output
+        QMutexLocker locker(&this->m_bufferMutex);
+        if (!this->m_output.isConfigured())
+            return;
+
+        // Frames left over from before the last stop are stale
+        this->m_output.discardPending();
+        this->m_active = true;
+    }
+    requestStart();
+}
+
+void HybrisCameraSource::requestStart()
+{
     QMetaObject::invokeMethod(this, "queueStart", Qt::QueuedConnection);
 }
 
@@ -180,28 +432,157 @@ void HybrisCameraSource::queueStart()
     android_camera_start_preview(this->m_control);
 }
 
+void HybrisCameraSource::notifyFrameAvailable()
+{
+    // Called on the camera HAL's thread. Only the first callback since the
+    // last handled frame wakes the camera thread, later ones just count.
+    this->m_frameTime = monotonicNanoseconds();
+    ++this->m_frameSequence;
+    if (this->m_pendingFrames.fetch_add(1) != 0)
+        return;
+
+    if (this->m_stats)
+        this->m_callbackTime = monotonicNanoseconds();
+
+    const uint64_t wakeup = 1;
+    if (write(this->m_frameEventFd, &wakeup, sizeof(wakeup)) < 0)
+        qWarning("Failed to signal frame availability: %s", strerror(errno));
+}
+
+void HybrisCameraSource::handleFrameAvailable()
+{
+    uint64_t wakeups;
+    if (read(this->m_frameEventFd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN)
+        qWarning("Failed to read frame eventfd: %s", strerror(errno));
+
+    // Timing of the newest callback counted in, a callback landing after
+    // the exchange belongs to the next pass
+    const unsigned int pending = this->m_pendingFrames.exchange(0);
+    this->m_latchedTime = this->m_frameTime;
+    this->m_latchedSequence = this->m_frameSequence;
+    if (pending == 0 || !this->m_output.isConfigured())
+        return;
+
+    if (this->m_stats)
+        this->m_stats->record(PipelineStats::Callback, this->m_callbackTime);
+
+    // Latch and release older buffers, only the newest gets rendered
+    if (pending > 1) {
+        this->m_skippedFrames += pending - 1;
+        if (this->m_stats)
+            this->m_stats->dropped += pending - 1;
+        for (unsigned int i = 1; i < pending; i++) {
+            StageTimer timer(this->m_stats, PipelineStats::UpdateTexture);
+            android_camera_update_preview_texture(this->m_control);
+        }
+    }
+
+    requestFrame();
+}
+
+quint64 HybrisCameraSource::skippedFrames()
+{
+    return this->m_skippedFrames;
+}
+
 void HybrisCameraSource::requestFrame()
 {
     QMutexLocker locker(&this->m_bufferMutex);
 
-    const bool mcSuccess = eglMakeCurrent(this->m_eglDisplay, this->m_eglSurface, this->m_eglSurface, this->m_eglContext);
-    if (!mcSuccess) {
-        qWarning() << "Failed to make current" << eglGetError();
+    if (!this->m_output.isConfigured())
         return;
-    }
 
     glActiveTexture(GL_TEXTURE1);
 
-    android_camera_update_preview_texture(this->m_control);
+    {
+        StageTimer timer(this->m_stats, PipelineStats::UpdateTexture);
+        android_camera_update_preview_texture(this->m_control);
+    }
+
+    // The texture now holds the newest frame the HAL announced before
+    // this pass, skipped ones leave gaps in the sequence
+    const quint64 timestamp = this->m_latchedTime;
+    const quint64 sequence = this->m_latchedSequence;
+
+    // Every started output renders the shared texture in a pass of its own
+    std::vector<FrameRef>& frames = this->m_renderedFrames;
+    if (this->m_active) {
+        frames.clear();
+        this->m_output.render(this->m_texture, timestamp, sequence, this->m_stats, &frames);
+        for (const FrameRef& frame : frames)
+            emit captured(frame);
+    }
+
+    for (const auto& output : this->m_outputs) {
+        if (!output->m_active)
+            continue;
+
+        frames.clear();
+        output->m_output.render(this->m_texture, timestamp, sequence, output->m_stats, &frames);
+        for (const FrameRef& frame : frames)
+            emit output->captured(frame);
+    }
+
+    // Frames stay with their consumers only
+    frames.clear();
+}
+
+void HybrisCameraSource::setAsyncReadback(bool enabled)
+{
+    QMutexLocker locker(&this->m_bufferMutex);
+
+    this->m_asyncReadback = enabled;
+    this->m_output.setAsyncReadback(enabled);
+    for (const auto& output : this->m_outputs)
+        output->m_output.setAsyncReadback(enabled);
+}
+
+void HybrisCameraSource::setQueueDepth(size_t frames)
+{
+    QMutexLocker locker(&this->m_bufferMutex);
+
+    FrameSource::setQueueDepth(frames);
+    this->m_output.setQueueDepth(frames);
+}
+
+bool HybrisCameraSource::setTransform(const FrameTransform& transform)
+{
+    if (!transform.isValid())
+        return false;
+
+    QMutexLocker locker(&this->m_bufferMutex);
+    this->m_output.setTransform(transform);
+    return true;
+}
+
+std::shared_ptr<HybrisCameraOutput> HybrisCameraSource::addOutput(const VideoFormat& format)
+{
+    if (!this->m_control || !supportedFormats().contains(format))
+        return nullptr;
+
+    std::shared_ptr<HybrisCameraOutput> output(new HybrisCameraOutput(this, format));
+    {
+        QMutexLocker locker(&this->m_bufferMutex);
+        output->m_output.setAsyncReadback(this->m_asyncReadback);
+        this->m_outputs.push_back(output);
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, this->m_fbo);
-    glBindTexture(GL_TEXTURE_EXTERNAL_OES, this->m_texture);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_EXTERNAL_OES, this->m_texture, 0);
-    glReadPixels(0, 0, this->width(), this->height(), GL_RGBA, GL_UNSIGNED_BYTE, (char*)this->m_pixelBuffer.data());
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    reconfigure();
+    qInfo() << "Added output" << format;
+    return output;
+}
+
+bool HybrisCameraSource::anyOutputActive()
+{
+    QMutexLocker locker(&this->m_bufferMutex);
 
-    emit captured(this->m_pixelBuffer);
+    if (this->m_active)
+        return true;
+    for (const auto& output : this->m_outputs) {
+        if (output->m_active)
+            return true;
+    }
+    return false;
 }
 
 void HybrisCameraSource::stop()
@@ -209,12 +590,148 @@ void HybrisCameraSource::stop()
     if (!this->m_control)
         return;
 
+    this->m_active = false;
+    requestStop();
+}
+
+void HybrisCameraSource::requestStop()
+{
     QMetaObject::invokeMethod(this, "queueDelayedStop", Qt::QueuedConnection);
 }
 
+void HybrisCameraSource::consumerOpened(const QString& consumer)
+{
+    this->m_stopPolicy.opened(consumer);
+}
+
+void HybrisCameraSource::consumerClosed(const QString& consumer)
+{
+    this->m_stopDelayMs = this->m_stopPolicy.closed(consumer);
+}
+
 void HybrisCameraSource::queueDelayedStop()
 {
-    qInfo() << "Stopping camera soon...";
+    // Other outputs still being read keep the camera going
+    if (anyOutputActive())
+        return;
+
+    const int delay = this->m_stopDelayMs;
+    qInfo() << "Stopping camera in" << delay << "ms...";
     this->m_stopDelayer.stop();
-    this->m_stopDelayer.start();
+    this->m_stopDelayer.start(delay);
+}
+
+HybrisCameraOutput::HybrisCameraOutput(HybrisCameraSource* camera, const VideoFormat& format) :
+    FrameSource(),
+    m_camera(camera),
+    m_format(format)
+{
+}
+
+void HybrisCameraOutput::start()
+{
+    if (!this->m_camera || !this->m_camera->m_control)
+        return;
+
+    {
+        QMutexLocker locker(&this->m_camera->m_bufferMutex);
+        if (!this->m_output.isConfigured())
+            return;
+
+        this->m_output.discardPending();
+        this->m_active = true;
+    }
+    this->m_camera->requestStart();
+}
+
+void HybrisCameraOutput::stop()
+{
+    if (!this->m_camera || !this->m_camera->m_control)
+        return;
+
+    this->m_active = false;
+    this->m_camera->requestStop();
+}
+
+size_t HybrisCameraOutput::width()
+{
+    return this->m_format.width;
+}
+
+size_t HybrisCameraOutput::height()
+{
+    return this->m_format.height;
+}
+
+PixelFormat HybrisCameraOutput::pixelFormat()
+{
+    if (!this->m_camera)
+        return this->m_format.pixelFormat;
+
+    QMutexLocker locker(&this->m_camera->m_bufferMutex);
+    return this->m_output.isConfigured() ? this->m_output.pixelFormat() : this->m_format.pixelFormat;
+}
+
+QVector<VideoFormat> HybrisCameraOutput::supportedFormats()
+{
+    return this->m_camera ? this->m_camera->supportedFormats() : QVector<VideoFormat>({ format() });
+}
+
+bool HybrisCameraOutput::setFormat(const VideoFormat& format)
+{
+    if (format == this->format())
+        return true;
+    if (!this->m_camera || !supportedFormats().contains(format))
+        return false;
+
+    {
+        QMutexLocker locker(&this->m_camera->m_bufferMutex);
+        this->m_format = format;
+    }
+    qInfo() << "Output switching to" << format;
+
+    this->m_camera->reconfigure();
+    return true;
+}
+
+int HybrisCameraOutput::frameRate()
+{
+    return this->m_camera ? this->m_camera->frameRate() : 0;
+}
+
+bool HybrisCameraOutput::setFrameRate(int fps)
+{
+    return this->m_camera && this->m_camera->setFrameRate(fps);
+}
+
+void HybrisCameraOutput::consumerOpened(const QString& consumer)
+{
+    if (this->m_camera)
+        this->m_camera->consumerOpened(consumer);
+}
+
+void HybrisCameraOutput::consumerClosed(const QString& consumer)
+{
+    if (this->m_camera)
+        this->m_camera->consumerClosed(consumer);
+}
+
+void HybrisCameraOutput::setQueueDepth(size_t frames)
+{
+    FrameSource::setQueueDepth(frames);
+    if (!this->m_camera)
+        return;
+
+    QMutexLocker locker(&this->m_camera->m_bufferMutex);
+    this->m_output.setQueueDepth(frames);
+}
+
+bool HybrisCameraOutput::setTransform(const FrameTransform& transform)
+{
+    if (!this->m_camera || !transform.isValid())
+        return false;
+
+    QMutexLocker locker(&this->m_camera->m_bufferMutex);
+    this->m_output.setTransform(transform);
+    return true;
 }
@@ -5,13 +5,24 @@
 #include <QByteArray>
 #include <QDebug>
 #include <QMutex>
+#include <QSocketNotifier>
 #include <QString>
+#include <QThread>
 #include <QTimer>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include <hybris/camera/camera_compatibility_layer.h>
 #include <hybris/camera/camera_compatibility_layer_capabilities.h>
 
 #include "eglhelper.h"
+#include "framepool.h"
+#include "framesource.h"
+#include "glframeoutput.h"
+#include "stopdelaypolicy.h"
+#include "videoformat.h"
 
 struct HybrisCameraInfo {
     int id = -1;
@@ -20,51 +31,168 @@ struct HybrisCameraInfo {
     int orientation;
 };
 
-class HybrisCameraSource : public QObject
+class HybrisCameraOutput;
+
+class HybrisCameraSource : public FrameSource
 {
     Q_OBJECT
 
 public:
     static QVector<HybrisCameraInfo> availableCameras();
 
+    // The source renders with its own context on its own thread,
+    // sharing objects with sharedContext.
     explicit HybrisCameraSource(HybrisCameraInfo info = HybrisCameraInfo(),
-                                EGLContext eglContext = EGL_NO_CONTEXT,
+                                EGLContext sharedContext = EGL_NO_CONTEXT,
                                 EGLDisplay eglDisplay = EGL_NO_DISPLAY,
-                                EGLSurface eglSurface = EGL_NO_SURFACE,
+                                PixelFormat format = PixelFormat::Rgba32,
                                 QObject *parent = nullptr);
     ~HybrisCameraSource();
-    void start();
-    void stop();
+    void start() override;
+    // The camera keeps running for as long as the consumers seen so far
+    // suggest they come back
+    void stop() override;
+    void consumerOpened(const QString& consumer) override;
+    void consumerClosed(const QString& consumer) override;
     Q_INVOKABLE void requestFrame();
 
-    void setSize(const size_t& width, const size_t& height);
-    size_t width();
-    size_t height();
+    // Frame-available callback from the camera HAL, any thread
+    void notifyFrameAvailable();
+    // Callbacks coalesced into a later frame
+    quint64 skippedFrames();
+
+    // Read back through a GLES3 pixel pack buffer ring when available
+    void setAsyncReadback(bool enabled);
+
+    void setQueueDepth(size_t frames) override;
+    // Applied on the GPU in the conversion pass, per output
+    bool setTransform(const FrameTransform& transform) override;
+
+    // Another format and size of this camera for a device of its own,
+    // null if the camera doesn't offer the format. Capture and texture
+    // updates are shared, each started output renders a pass of its own.
+    std::shared_ptr<HybrisCameraOutput> addOutput(const VideoFormat& format);
+
+    // Preview size offered by the camera, the largest one is captured
+    void addPreviewSize(const size_t& width, const size_t& height);
+    size_t captureWidth();
+    size_t captureHeight();
+
+    // Size frames are scaled to on the GPU, defaults to the capture size
+    // scaled down to fit 720p
+    bool setOutputSize(size_t width, size_t height);
+    size_t width() override;
+    size_t height() override;
+    PixelFormat pixelFormat() override;
+
+    // Any format converted on the GPU or CPU, at the capture size or below
+    QVector<VideoFormat> supportedFormats() override;
+    bool setFormat(const VideoFormat& format) override;
+
+    // Clamped to the preview fps range the camera reports
+    int frameRate() override;
+    bool setFrameRate(int fps) override;
 
     QMutex* bufferMutex();
 
 private slots:
+    void initializeGl();
+    void configureOutput();
+    void releaseGl();
     void queueStart();
     void queueDelayedStop();
+    void handleFrameAvailable();
 
 private:
+    friend class HybrisCameraOutput;
+
+    void requestStart();
+    void requestStop();
+    void disconnectCamera();
+    bool anyOutputActive();
+    void reconfigure();
+
     CameraControl* m_control = nullptr;
     CameraControlListener* m_listener = nullptr;
 
+    size_t m_captureWidth = 0;
+    size_t m_captureHeight = 0;
     size_t m_width = 0;
     size_t m_height = 0;
-    short m_fps;
-    GLuint m_fbo;
-    GLuint m_texture;
+    int m_fps = 0;
+    int m_minFps = 0;
+    int m_maxFps = 0;
+    PixelFormat m_format = PixelFormat::Rgba32;
+    GLuint m_texture = 0;
+    bool m_asyncReadback = true;
+    // Guards the outputs against reconfiguration while rendering
     QMutex m_bufferMutex;
-    QByteArray m_pixelBuffer;
-    EGLContext m_eglContext;
+    GlFrameOutput m_output;
+    // Whether this source's own output is started
+    std::atomic<bool> m_active { false };
+    std::vector<std::shared_ptr<HybrisCameraOutput>> m_outputs;
+    // Frames one output finished in a pass, reused so frames don't
+    // allocate
+    std::vector<FrameRef> m_renderedFrames;
+    EGLContext m_sharedContext;
+    EGLContext m_eglContext = EGL_NO_CONTEXT;
     EGLDisplay m_eglDisplay;
-    EGLSurface m_eglSurface;
+    EGLSurface m_eglSurface = EGL_NO_SURFACE;
+    QThread* m_thread;
+    int m_frameEventFd = -1;
+    QSocketNotifier* m_frameNotifier = nullptr;
+    std::atomic<unsigned int> m_pendingFrames { 0 };
+    // When the first of the pending callbacks came in
+    std::atomic<quint64> m_callbackTime { 0 };
+    // When the newest callback came in and how many came in so far, the
+    // HAL doesn't pass the SurfaceTexture timestamp through
+    std::atomic<quint64> m_frameTime { 0 };
+    std::atomic<quint64> m_frameSequence { 0 };
+    // Both as they were when the camera thread took the pending
+    // callbacks, stamped on the frames rendered from them
+    quint64 m_latchedTime = 0;
+    quint64 m_latchedSequence = 0;
+    quint64 m_skippedFrames = 0;
     QTimer m_stopDelayer;
+    StopDelayPolicy m_stopPolicy;
+    std::atomic<int> m_stopDelayMs { StopDelayPolicy::DEFAULT_DELAY_MS };
+};
+
+// Additional output of a HybrisCameraSource, see addOutput(). Renders
+// only while started, the camera runs while any of its outputs is.
+// Rates and consumers are shared with the camera.
+class HybrisCameraOutput : public FrameSource
+{
+    Q_OBJECT
+
+public:
+    void start() override;
+    void stop() override;
+
+    size_t width() override;
+    size_t height() override;
+    PixelFormat pixelFormat() override;
+
+    QVector<VideoFormat> supportedFormats() override;
+    bool setFormat(const VideoFormat& format) override;
+
+    int frameRate() override;
+    bool setFrameRate(int fps) override;
+    void consumerOpened(const QString& consumer) override;
+    void consumerClosed(const QString& consumer) override;
+    void setQueueDepth(size_t frames) override;
+    bool setTransform(const FrameTransform& transform) override;
+
+private:
+    friend class HybrisCameraSource;
+
+    HybrisCameraOutput(HybrisCameraSource* camera, const VideoFormat& format);
 
-signals:
-    void captured(QByteArray frame);
+    // Cleared when the camera goes away first
+    HybrisCameraSource* m_camera;
+    VideoFormat m_format;
+    GlFrameOutput m_output;
+    std::atomic<bool> m_active { false };
 };
 
 #endif // HYBRISCAMERASOURCE_H
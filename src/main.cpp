@@ -1,6 +1,10 @@
+#include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QDir>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QPair>
@@ -8,8 +12,10 @@
 #include <QVector>
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <set>
+#include <thread>
 
 #include <grp.h>
 #include <pwd.h>
@@ -20,12 +26,35 @@
 
 #include "eglhelper.h"
 #include "accessmediator.h"
+#include "bufferingprofile.h"
+#include "camerabridge.h"
+#include "fileframesource.h"
+#include "framepool.h"
 #include "hybriscamerasource.h"
+#include "mjpegencoder.h"
+#include "sharedmemorysink.h"
+#include "statsservice.h"
+#include "syntheticframesource.h"
+#include "transformservice.h"
 #include "v4l2loopbacksink.h"
+#include "videoformat.h"
 
-struct SourceSinkPair {
-    std::shared_ptr<HybrisCameraSource> source;
-    std::shared_ptr<V4L2LoopbackSink> sink;
+struct SourceDescription {
+    std::shared_ptr<FrameSource> source;
+    QString description;
+    // Whether the source's I420 gets encoded to MJPEG
+    bool encodeJpeg;
+    BufferingProfile buffering;
+    FrameTransform transform;
+};
+
+// Another device per camera, 0x0 takes the camera's output size
+struct ExtraOutput {
+    QString name;
+    PixelFormat format;
+    size_t width;
+    size_t height;
+    BufferingProfile buffering;
 };
 
 static void sig_handler(int sig_num)
@@ -34,13 +63,26 @@ static void sig_handler(int sig_num)
     exit(0);
 }
 
+// Runs job(0) to job(count - 1) on threads of their own and waits for all
+static void runConcurrently(int count, const std::function<void(int)>& job)
+{
+    std::vector<std::thread> threads;
+    for (int i = 1; i < count; i++)
+        threads.emplace_back(job, i);
+    if (count > 0)
+        job(0);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
 int main(int argc, char *argv[])
 {
     // Get to the chopper
     chdir("/");
 
     // Query available cameras and create the bridges
-    std::vector<SourceSinkPair> bridges;
+    std::vector<std::unique_ptr<CameraBridge>> bridges;
+    std::vector<SourceDescription> sources;
 
     // This requires EGL
     EGLDisplay display;
@@ -48,25 +90,259 @@ int main(int argc, char *argv[])
     EGLSurface surface;
 
     QCoreApplication a(argc, argv);
+    qRegisterMetaType<FrameRef>("FrameRef");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Video-4-Linux bridge using libhybris & v4l2loopback");
+    parser.addHelpOption();
+    const QCommandLineOption sourceOption("source",
+                                          "Frame source to use: hybris, synthetic or file.",
+                                          "type", "hybris");
+    const QCommandLineOption sizeOption("size",
+                                        "Frame size of synthetic and file sources. Cameras scale to it "
+                                        "(default: fit 1280x720), or capture size with \"native\".",
+                                        "WIDTHxHEIGHT", "1280x720");
+    const QCommandLineOption fpsOption("fps",
+                                       "Frame rate until a consumer asks for another one, cameras pick "
+                                       "the closest rate they support.",
+                                       "fps", "30");
+    const QCommandLineOption fileOption("file",
+                                        "Raw file replayed by the file source, in --format (I420 for mjpeg).",
+                                        "path");
+    const QCommandLineOption formatOption("format",
+                                          "Output pixel format: rgba, rgb24, bgr24, yuyv, nv12, nv21, i420 or mjpeg.",
+                                          "format", "rgba");
+    const QCommandLineOption ioOption("io",
+                                      "Loopback I/O mode: mmap (streaming, falls back to write) or write.",
+                                      "mode", "mmap");
+    parser.addOption(sourceOption);
+    parser.addOption(sizeOption);
+    parser.addOption(fpsOption);
+    parser.addOption(fileOption);
+    parser.addOption(ioOption);
+    parser.addOption(formatOption);
+    const QCommandLineOption readbackOption("readback",
+                                            "Camera readback: async (GLES3 pixel pack buffers, falls back to sync) or sync.",
+                                            "mode", "async");
+    parser.addOption(readbackOption);
+    const QCommandLineOption jpegQualityOption("jpeg-quality",
+                                               "JPEG quality of the mjpeg format, 1 to 100.",
+                                               "quality", QString::number(MjpegEncoder::DEFAULT_QUALITY));
+    const QCommandLineOption jpegThreadsOption("jpeg-threads",
+                                               "Threads encoding each mjpeg stream, 0 for one per core up to four.",
+                                               "count", "0");
+    parser.addOption(jpegQualityOption);
+    parser.addOption(jpegThreadsOption);
+    const QCommandLineOption pacingOption("pacing",
+                                          "Output pacing: on (steady rate, drops or repeats frames) or off.",
+                                          "mode", "on");
+    parser.addOption(pacingOption);
+    const QCommandLineOption rotationOption("rotation",
+                                            "Clockwise rotation on the GPU: 0, 90, 180, 270 or auto for the "
+                                            "camera's mounting angle. Hybris source only.",
+                                            "degrees", "0");
+    const QCommandLineOption mirrorFrontOption("mirror-front",
+                                               "Mirror front-facing cameras on the GPU.");
+    const QCommandLineOption cropOption("crop",
+                                        "Centre-crop cameras to the output's aspect ratio instead of "
+                                        "stretching them.");
+    parser.addOption(rotationOption);
+    parser.addOption(mirrorFrontOption);
+    parser.addOption(cropOption);
+    const QCommandLineOption bufferingOption("buffering",
+                                             "Device buffering: low-latency, smooth or recording.",
+                                             "profile", "low-latency");
+    parser.addOption(bufferingOption);
+    const QCommandLineOption extraOutputOption("extra-output",
+                                               "Another device per camera in its own format, at the camera's size "
+                                               "and buffering unless given. Repeatable, hybris source only.",
+                                               "format[@WIDTHxHEIGHT][:profile]");
+    parser.addOption(extraOutputOption);
+    const QCommandLineOption shmDirOption("shm-dir",
+                                          "Also offer every device's frames through a shared memory ring, "
+                                          "on a socket per device in this directory.",
+                                          "directory");
+    parser.addOption(shmDirOption);
+    parser.process(a);
 
-    const bool initSuccess = initEgl(&context, &display, &surface);
-    if (!initSuccess) {
-        qFatal("EGL not initialized");
+    const QString sourceType = parser.value(sourceOption);
+    const bool nativeSize = parser.value(sizeOption) == QStringLiteral("native");
+    size_t width = 0, height = 0;
+    if (!(nativeSize && sourceType == QStringLiteral("hybris"))
+            && !parseFrameSize(parser.value(sizeOption), &width, &height)) {
+        qFatal("Invalid frame size: %s", parser.value(sizeOption).toUtf8().data());
+        return 1;
+    }
+    const int fps = parser.value(fpsOption).toInt();
+
+    PixelFormat format;
+    if (!parsePixelFormat(parser.value(formatOption), &format)) {
+        qFatal("Unknown pixel format: %s", parser.value(formatOption).toUtf8().data());
+        return 1;
+    }
+
+    // MJPEG is encoded from I420 coming out of the source
+    const bool encodeJpeg = format == PixelFormat::Mjpeg;
+    const PixelFormat sourceFormat = encodeJpeg ? PixelFormat::I420 : format;
+    const int jpegQuality = parser.value(jpegQualityOption).toInt();
+    const int jpegThreads = parser.value(jpegThreadsOption).toInt();
+
+    if (sourceType != QStringLiteral("hybris") && !pixelFormatSupportsSize(format, width, height)) {
+        qFatal("Frame size %zux%zu does not fit format %s", width, height, parser.value(formatOption).toUtf8().data());
+        return 1;
+    }
+
+    const bool pacing = parser.value(pacingOption) != QStringLiteral("off");
+
+    BufferingProfile buffering;
+    if (!parseBufferingProfile(parser.value(bufferingOption), &buffering)) {
+        qFatal("Unknown buffering profile: %s", parser.value(bufferingOption).toUtf8().data());
+        return 1;
+    }
+
+    // Per camera rotation and mirroring are filled in once cameras are known
+    const bool autoRotation = parser.value(rotationOption) == QStringLiteral("auto");
+    FrameTransform transform;
+    transform.rotation = parser.value(rotationOption).toInt();
+    transform.crop = parser.isSet(cropOption);
+    if (!autoRotation && !transform.isValid()) {
+        qFatal("Invalid rotation: %s", parser.value(rotationOption).toUtf8().data());
+        return 1;
+    }
+
+    std::vector<ExtraOutput> extraOutputs;
+    for (const QString& value : parser.values(extraOutputOption)) {
+        const QStringList profileParts = value.split(QLatin1Char(':'));
+        const QStringList parts = profileParts.first().split(QLatin1Char('@'));
+        ExtraOutput output = { profileParts.first(), PixelFormat::Rgba32, 0, 0, buffering };
+        if (profileParts.size() > 2 || parts.size() > 2 || !parsePixelFormat(parts.first(), &output.format)
+                || (parts.size() == 2 && !parseFrameSize(parts.last(), &output.width, &output.height))
+                || (profileParts.size() == 2 && !parseBufferingProfile(profileParts.last(), &output.buffering))) {
+            qFatal("Invalid extra output: %s", value.toUtf8().data());
+            return 1;
+        }
+        extraOutputs.push_back(output);
+    }
+    if (!extraOutputs.empty() && sourceType != QStringLiteral("hybris")) {
+        qFatal("Extra outputs need the hybris source");
+        return 1;
+    }
+
+    V4L2LoopbackSink::IoMode ioMode;
+    if (parser.value(ioOption) == QStringLiteral("mmap")) {
+        ioMode = V4L2LoopbackSink::StreamingIo;
+    } else if (parser.value(ioOption) == QStringLiteral("write")) {
+        ioMode = V4L2LoopbackSink::WriteIo;
+    } else {
+        qFatal("Unknown I/O mode: %s", parser.value(ioOption).toUtf8().data());
         return 1;
     }
 
     signal(SIGINT, sig_handler);
 
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    qint64 eglTime = 0;
+    qint64 sourcesTime = 0;
+
+    if (sourceType == QStringLiteral("hybris")) {
+        const bool initSuccess = initEgl(&context, &display, &surface);
+        if (!initSuccess) {
+            qFatal("EGL not initialized");
+            return 1;
+        }
+        eglTime = startupTimer.elapsed();
+
+        // Cameras connect one after the other on this thread, the HAL
+        // isn't known to take parallel connects and every source has to
+        // belong to a thread with an event loop
+        for (const HybrisCameraInfo &cameraInfo : HybrisCameraSource::availableCameras()) {
+            auto source = std::make_shared<HybrisCameraSource>(cameraInfo,
+                                                               context,
+                                                               display,
+                                                               sourceFormat);
+            source->setAsyncReadback(parser.value(readbackOption) != QStringLiteral("sync"));
+            source->setFrameRate(fps);
+            if (nativeSize)
+                source->setOutputSize(source->captureWidth(), source->captureHeight());
+            else if (parser.isSet(sizeOption))
+                source->setOutputSize(width, height);
+
+            // The HAL's own rotation often misses the preview texture
+            FrameTransform cameraTransform = transform;
+            if (autoRotation)
+                cameraTransform.rotation = cameraInfo.orientation;
+            cameraTransform.mirror = parser.isSet(mirrorFrontOption)
+                    && cameraInfo.facingDirection == FRONT_FACING_CAMERA_TYPE;
+            sources.push_back({source, cameraInfo.description, encodeJpeg, buffering, cameraTransform});
+
+            // Rendered from the same capture, MJPEG again from I420
+            for (const ExtraOutput& extra : extraOutputs) {
+                const size_t outputWidth = extra.width ? extra.width : source->width();
+                const size_t outputHeight = extra.height ? extra.height : source->height();
+                const PixelFormat outputFormat = extra.format == PixelFormat::Mjpeg ? PixelFormat::I420 : extra.format;
+                std::shared_ptr<FrameSource> output;
+                if (pixelFormatSupportsSize(extra.format, outputWidth, outputHeight))
+                    output = source->addOutput(VideoFormat(outputFormat, outputWidth, outputHeight));
+                if (!output) {
+                    qWarning("%s can't provide %s, skipping",
+                             cameraInfo.description.toUtf8().data(), extra.name.toUtf8().data());
+                    continue;
+                }
+                sources.push_back({output, cameraInfo.description + QStringLiteral(" ") + extra.name,
+                                   extra.format == PixelFormat::Mjpeg, extra.buffering, cameraTransform});
+            }
+        }
+    } else if (sourceType == QStringLiteral("synthetic")) {
+        auto source = std::make_shared<SyntheticFrameSource>(width, height, fps, sourceFormat);
+        sources.push_back({source, QStringLiteral("Synthetic camera"), encodeJpeg, buffering, transform});
+    } else if (sourceType == QStringLiteral("file")) {
+        if (!parser.isSet(fileOption)) {
+            qFatal("The file source requires --file");
+            return 1;
+        }
+        auto source = std::make_shared<FileFrameSource>(parser.value(fileOption), width, height, fps, sourceFormat);
+        sources.push_back({source, QStringLiteral("File replay"), encodeJpeg, buffering, transform});
+    } else {
+        qFatal("Unknown source type: %s", sourceType.toUtf8().data());
+        return 1;
+    }
+
+    for (SourceDescription &entry : sources) {
+        if (!entry.encodeJpeg)
+            continue;
+        if (!pixelFormatSupportsSize(PixelFormat::Mjpeg, entry.source->width(), entry.source->height())) {
+            qFatal("Frame size %zux%zu does not fit format mjpeg", entry.source->width(), entry.source->height());
+            return 1;
+        }
+        entry.source = std::make_shared<MjpegEncoder>(entry.source, jpegQuality, jpegThreads);
+    }
+
+    sourcesTime = startupTimer.elapsed() - eglTime;
+
     AccessMediator mediator;
+    StatsService statsService;
+    TransformService transformService;
 
-    for (const HybrisCameraInfo &cameraInfo : HybrisCameraSource::availableCameras()) {
-        auto source = std::make_shared<HybrisCameraSource>(cameraInfo,
-                                                           context,
-                                                           display,
-                                                           surface);
+    for (const SourceDescription &entry : sources) {
+        const std::shared_ptr<FrameSource> &source = entry.source;
         auto sink = std::make_shared<V4L2LoopbackSink>(source->width(),
                                                        source->height(),
-                                                       cameraInfo.description);
+                                                       source->pixelFormat(),
+                                                       entry.description);
+        sink->setIoMode(ioMode);
+        sink->setSupportedFormats(source->supportedFormats());
+        sink->setPacing(pacing);
+
+        // Frames waiting in the writer queue come out of the source's pool
+        sink->setBufferingProfile(entry.buffering);
+        source->setQueueDepth(bufferingSettings(entry.buffering).queueDepth);
+
+        // Timings and counters of the whole camera pipeline
+        std::shared_ptr<PipelineStats> stats = statsService.addPipeline(entry.description);
+        source->setStats(stats);
+        sink->setStats(stats);
+        sink->setFrameRate(source->frameRate());
 
         // Register created device with the mediator
         QObject::connect(sink.get(), &V4L2LoopbackSink::deviceCreated,
@@ -74,22 +350,47 @@ int main(int argc, char *argv[])
         QObject::connect(sink.get(), &V4L2LoopbackSink::deviceRemoved,
                          &mediator, &AccessMediator::unregisterDevice, Qt::DirectConnection);
 
-        // Cause open() on devices to start frame feed
-        QObject::connect(&mediator, &AccessMediator::accessAllowed,
-                         sink.get(), &V4L2LoopbackSink::feedDummyFrame, Qt::DirectConnection);
+        // Only the bridge owning the opened device reacts
+        bridges.emplace_back(new CameraBridge(source, sink));
+        CameraBridge* bridge = bridges.back().get();
         QObject::connect(&mediator, &AccessMediator::accessAllowed,
-                         source.get(), &HybrisCameraSource::start, Qt::DirectConnection);
+                         bridge, &CameraBridge::accessAllowed, Qt::DirectConnection);
         QObject::connect(&mediator, &AccessMediator::deviceClosed,
-                         source.get(), &HybrisCameraSource::stop, Qt::DirectConnection);
+                         bridge, &CameraBridge::deviceClosed, Qt::DirectConnection);
 
-        // Frame passing through one-way communication from source to sink
-        QObject::connect(source.get(), &HybrisCameraSource::captured,
-                         sink.get(), &V4L2LoopbackSink::pushCapture, Qt::DirectConnection);
+        if (entry.transform != FrameTransform() && !bridge->setTransform(entry.transform))
+            qWarning() << entry.description << "can't apply" << entry.transform;
+        transformService.addBridge(bridge);
+    }
+
+    // Every new device waits for udev, so they are all created at once
+    const qint64 devicesStart = startupTimer.elapsed();
+    runConcurrently(bridges.size(), [&bridges](int i) {
+        bridges[i]->sink()->run();
+    });
+    const qint64 devicesTime = startupTimer.elapsed() - devicesStart;
+
+    // Rings are named after their device, so they follow its creation
+    if (parser.isSet(shmDirOption)) {
+        const QDir shmDir(parser.value(shmDirOption));
+        for (const std::unique_ptr<CameraBridge>& bridge : bridges) {
+            if (!bridge->sink()->isOpen())
+                continue;
 
-        sink->run();
-        bridges.push_back({source, sink});
+            auto ring = std::make_shared<SharedMemorySink>();
+            ring->setSupportedFormats(bridge->source()->supportedFormats());
+            const QString name = QFileInfo(bridge->sink()->path()).fileName() + QStringLiteral(".sock");
+            if (ring->listen(shmDir.filePath(name)))
+                bridge->setSharedMemorySink(ring);
+        }
     }
 
+    qInfo("Started %zu cameras in %lld ms: EGL %lld ms, sources %lld ms, devices %lld ms",
+          bridges.size(), startupTimer.elapsed(), eglTime, sourcesTime, devicesTime);
+
+    statsService.registerOnBus();
+    transformService.registerOnBus();
+
     // Run the service
     int ret = a.exec();
 
@@ -0,0 +1,386 @@
+#include "mjpegencoder.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+// Rows handed to libjpeg per call, one MCU row at 4:2:0
+static const size_t MCU_ROWS = 16;
+static const int MAX_THREADS = 4;
+
+MjpegCompressor::MjpegCompressor()
+{
+    this->m_cinfo.err = jpeg_std_error(&this->m_error.pub);
+    this->m_error.pub.error_exit = MjpegCompressor::errorExit;
+    this->m_error.pub.output_message = MjpegCompressor::outputMessage;
+    jpeg_create_compress(&this->m_cinfo);
+
+    this->m_destination.pub.init_destination = MjpegCompressor::initDestination;
+    this->m_destination.pub.empty_output_buffer = MjpegCompressor::emptyOutputBuffer;
+    this->m_destination.pub.term_destination = MjpegCompressor::termDestination;
+    this->m_cinfo.dest = &this->m_destination.pub;
+}
+
+MjpegCompressor::~MjpegCompressor()
+{
+    jpeg_destroy_compress(&this->m_cinfo);
+}
+
+size_t MjpegCompressor::compress(const uint8_t* source, size_t width, size_t height, int quality,
+                                 uint8_t* destination, size_t capacity)
+{
+    this->m_destination.data = destination;
+    this->m_destination.capacity = capacity;
+    this->m_destination.overflow = false;
+
+    if (setjmp(this->m_error.jump)) {
+        jpeg_abort_compress(&this->m_cinfo);
+        return 0;
+    }
+
+    this->m_cinfo.image_width = width;
+    this->m_cinfo.image_height = height;
+    this->m_cinfo.input_components = 3;
+    this->m_cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&this->m_cinfo);
+    jpeg_set_quality(&this->m_cinfo, quality, TRUE);
+
+    // Planes go in as they are, no colour conversion or downsampling
+    this->m_cinfo.raw_data_in = TRUE;
+    this->m_cinfo.dct_method = JDCT_IFAST;
+    this->m_cinfo.comp_info[0].h_samp_factor = 2;
+    this->m_cinfo.comp_info[0].v_samp_factor = 2;
+    this->m_cinfo.comp_info[1].h_samp_factor = 1;
+    this->m_cinfo.comp_info[1].v_samp_factor = 1;
+    this->m_cinfo.comp_info[2].h_samp_factor = 1;
+    this->m_cinfo.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress(&this->m_cinfo, TRUE);
+
+    const size_t chromaWidth = width / 2;
+    const size_t chromaHeight = height / 2;
+    const uint8_t* lumaPlane = source;
+    const uint8_t* cbPlane = lumaPlane + width * height;
+    const uint8_t* crPlane = cbPlane + chromaWidth * chromaHeight;
+
+    JSAMPROW lumaRows[MCU_ROWS];
+    JSAMPROW cbRows[MCU_ROWS / 2];
+    JSAMPROW crRows[MCU_ROWS / 2];
+    JSAMPARRAY planes[3] = { lumaRows, cbRows, crRows };
+
+    // The last MCU row repeats the bottom line when the height isn't
+    // a multiple of 16
+    for (size_t y = 0; y < height; y += MCU_ROWS) {
+        for (size_t i = 0; i < MCU_ROWS; i++) {
+            const size_t row = std::min(y + i, height - 1);
+            lumaRows[i] = (JSAMPROW)(lumaPlane + row * width);
+        }
+        for (size_t i = 0; i < MCU_ROWS / 2; i++) {
+            const size_t row = std::min(y / 2 + i, chromaHeight - 1);
+            cbRows[i] = (JSAMPROW)(cbPlane + row * chromaWidth);
+            crRows[i] = (JSAMPROW)(crPlane + row * chromaWidth);
+        }
+        jpeg_write_raw_data(&this->m_cinfo, planes, MCU_ROWS);
+    }
+
+    jpeg_finish_compress(&this->m_cinfo);
+
+    if (this->m_destination.overflow) {
+        qWarning("JPEG frame exceeded its %zu byte buffer", capacity);
+        return 0;
+    }
+    return capacity - this->m_destination.pub.free_in_buffer;
+}
+
+void MjpegCompressor::errorExit(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    qWarning("JPEG compression failed: %s", message);
+
+    longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+}
+
+void MjpegCompressor::outputMessage(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    qWarning("JPEG: %s", message);
+}
+
+void MjpegCompressor::initDestination(j_compress_ptr cinfo)
+{
+    Destination* destination = reinterpret_cast<Destination*>(cinfo->dest);
+    destination->pub.next_output_byte = destination->data;
+    destination->pub.free_in_buffer = destination->capacity;
+}
+
+boolean MjpegCompressor::emptyOutputBuffer(j_compress_ptr cinfo)
+{
+    // Out of room, run the rest of the frame into the spill buffer so
+    // libjpeg can finish and drop it afterwards
+    Destination* destination = reinterpret_cast<Destination*>(cinfo->dest);
+    destination->overflow = true;
+    destination->pub.next_output_byte = destination->spill;
+    destination->pub.free_in_buffer = sizeof(destination->spill);
+    return TRUE;
+}
+
+void MjpegCompressor::termDestination(j_compress_ptr cinfo)
+{
+    Q_UNUSED(cinfo);
+}
+
+class MjpegWorker : public QThread
+{
+public:
+    explicit MjpegWorker(MjpegEncoder* encoder) : m_encoder(encoder) {}
+
+protected:
+    void run() override { this->m_encoder->work(); }
+
+private:
+    MjpegEncoder* m_encoder;
+};
+
+MjpegEncoder::MjpegEncoder(std::shared_ptr<FrameSource> upstream, int quality, int threads,
+                           QObject *parent) :
+    FrameSource(parent),
+    m_upstream(upstream),
+    m_quality(std::max(1, std::min(quality, 100)))
+{
+    if (threads <= 0)
+        threads = std::max(1, std::min(QThread::idealThreadCount(), MAX_THREADS));
+
+    for (int i = 0; i < threads; i++) {
+        QThread* worker = new MjpegWorker(this);
+        worker->start();
+        this->m_workers.push_back(worker);
+    }
+    resetPool();
+
+    // Only queues the frame, safe on whatever thread the upstream emits from
+    QObject::connect(this->m_upstream.get(), &FrameSource::captured,
+                     this, &MjpegEncoder::encode, Qt::DirectConnection);
+
+    qInfo() << "MJPEG encoding" << this->m_upstream->format() << "at quality"
+            << this->m_quality.load() << "on" << threads << "threads";
+}
+
+MjpegEncoder::~MjpegEncoder()
+{
+    QObject::disconnect(this->m_upstream.get(), &FrameSource::captured,
+                        this, &MjpegEncoder::encode);
+    {
+        QMutexLocker locker(&this->m_jobMutex);
+        this->m_quit = true;
+        this->m_jobAvailable.wakeAll();
+    }
+
+    for (QThread* worker : this->m_workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void MjpegEncoder::start()
+{
+    this->m_upstream->start();
+}
+
+void MjpegEncoder::stop()
+{
+    this->m_upstream->stop();
+
+    QMutexLocker locker(&this->m_jobMutex);
+    if (this->m_dropped > 0)
+        qInfo("MJPEG encoder dropped %llu frames so far", this->m_dropped);
+}
+
+size_t MjpegEncoder::width()
+{
+    return this->m_upstream->width();
+}
+
+size_t MjpegEncoder::height()
+{
+    return this->m_upstream->height();
+}
+
+PixelFormat MjpegEncoder::pixelFormat()
+{
+    return PixelFormat::Mjpeg;
+}
+
+QVector<VideoFormat> MjpegEncoder::supportedFormats()
+{
+    QVector<VideoFormat> formats;
+    for (const VideoFormat& format : this->m_upstream->supportedFormats()) {
+        if (format.pixelFormat == PixelFormat::I420
+                && pixelFormatSupportsSize(PixelFormat::Mjpeg, format.width, format.height))
+            formats.append(VideoFormat(PixelFormat::Mjpeg, format.width, format.height));
+    }
+    return formats;
+}
+
+bool MjpegEncoder::setFormat(const VideoFormat& format)
+{
+    if (format.pixelFormat != PixelFormat::Mjpeg
+            || !pixelFormatSupportsSize(format.pixelFormat, format.width, format.height))
+        return false;
+
+    if (!this->m_upstream->setFormat(VideoFormat(PixelFormat::I420, format.width, format.height)))
+        return false;
+
+    QMutexLocker locker(&this->m_jobMutex);
+    resetPool();
+    return true;
+}
+
+bool MjpegEncoder::setTransform(const FrameTransform& transform)
+{
+    return this->m_upstream->setTransform(transform);
+}
+
+void MjpegEncoder::setQueueDepth(size_t frames)
+{
+    QMutexLocker locker(&this->m_jobMutex);
+    FrameSource::setQueueDepth(frames);
+    resetPool();
+}
+
+int MjpegEncoder::frameRate()
+{
+    return this->m_upstream->frameRate();
+}
+
+bool MjpegEncoder::setFrameRate(int fps)
+{
+    return this->m_upstream->setFrameRate(fps);
+}
+
+void MjpegEncoder::consumerOpened(const QString& consumer)
+{
+    this->m_upstream->consumerOpened(consumer);
+}
+
+void MjpegEncoder::consumerClosed(const QString& consumer)
+{
+    this->m_upstream->consumerClosed(consumer);
+}
+
+void MjpegEncoder::setStats(std::shared_ptr<PipelineStats> stats)
+{
+    FrameSource::setStats(stats);
+    this->m_upstream->setStats(stats);
+}
+
+void MjpegEncoder::setQuality(int quality)
+{
+    this->m_quality = std::max(1, std::min(quality, 100));
+}
+
+int MjpegEncoder::quality()
+{
+    return this->m_quality;
+}
+
+quint64 MjpegEncoder::droppedFrames()
+{
+    QMutexLocker locker(&this->m_jobMutex);
+    return this->m_dropped;
+}
+
+void MjpegEncoder::resetPool()
+{
+    // One output buffer per worker on top of what the sink may hold
+    const size_t frameSize = pixelFormatFrameSize(PixelFormat::Mjpeg, width(), height());
+    this->m_framePool.reset(new FramePool(frameSize, FramePool::DEFAULT_BUFFER_COUNT + this->m_queueDepth
+                                                     + this->m_workers.size()));
+}
+
+void MjpegEncoder::encode(FrameRef frame)
+{
+    if (frame.isNull())
+        return;
+
+    QMutexLocker locker(&this->m_jobMutex);
+
+    // Encoding can't keep up, dropping here keeps latency bounded
+    if (this->m_quit || this->m_jobs.size() >= this->m_workers.size()) {
+        ++this->m_dropped;
+        if (this->m_stats)
+            ++this->m_stats->dropped;
+        return;
+    }
+
+    Job job;
+    job.sequence = this->m_nextSequence++;
+    job.frame = frame;
+    job.format = this->m_upstream->format();
+    this->m_jobs.push_back(job);
+    this->m_jobAvailable.wakeOne();
+}
+
+void MjpegEncoder::work()
+{
+    MjpegCompressor compressor;
+
+    for (;;) {
+        Job job;
+        FrameRef output;
+        {
+            QMutexLocker locker(&this->m_jobMutex);
+            while (this->m_jobs.empty() && !this->m_quit)
+                this->m_jobAvailable.wait(&this->m_jobMutex);
+            if (this->m_quit)
+                return;
+
+            job = this->m_jobs.front();
+            this->m_jobs.pop_front();
+            output = this->m_framePool->acquire();
+        }
+
+        // Frames still in the previous format after a switch can't be
+        // told apart from the new ones otherwise
+        size_t size = 0;
+        if (!output.isNull()
+                && job.format.pixelFormat == PixelFormat::I420
+                && job.frame.size() == job.format.frameSize()
+                && output.capacity() == pixelFormatFrameSize(PixelFormat::Mjpeg, job.format.width, job.format.height)) {
+            size = compressor.compress(job.frame.data(), job.format.width, job.format.height,
+                                       this->m_quality, output.data(), output.capacity());
+        }
+        output.copyTiming(job.frame);
+        job.frame.reset();
+
+        if (size > 0) {
+            output.setSize(size);
+        } else {
+            output.reset();
+            if (this->m_stats)
+                ++this->m_stats->dropped;
+            QMutexLocker locker(&this->m_jobMutex);
+            ++this->m_dropped;
+        }
+
+        finish(job.sequence, output);
+    }
+}
+
+void MjpegEncoder::finish(quint64 sequence, FrameRef frame)
+{
+    // Workers finish out of order, frames leave in the order they came
+    QMutexLocker locker(&this->m_finishMutex);
+    this->m_finished[sequence] = frame;
+
+    while (!this->m_finished.empty() && this->m_finished.begin()->first == this->m_nextEmitted) {
+        FrameRef next = this->m_finished.begin()->second;
+        this->m_finished.erase(this->m_finished.begin());
+        ++this->m_nextEmitted;
+
+        if (!next.isNull())
+            emit captured(next);
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef MJPEGENCODER_H
+#define MJPEGENCODER_H
+
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <csetjmp>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "framepool.h"
+#include "framesource.h"
+#include "videoformat.h"
+
+// One libjpeg compressor, reused frame after frame. Not thread-safe,
+// every encoding thread owns its own.
+class MjpegCompressor
+{
+public:
+    MjpegCompressor();
+    ~MjpegCompressor();
+
+    // Encodes an I420 frame into destination, returns the JPEG's size
+    // or 0 if it failed or didn't fit
+    size_t compress(const uint8_t* source, size_t width, size_t height, int quality,
+                    uint8_t* destination, size_t capacity);
+
+private:
+    struct ErrorManager {
+        jpeg_error_mgr pub;
+        jmp_buf jump;
+    };
+
+    struct Destination {
+        jpeg_destination_mgr pub;
+        uint8_t* data = nullptr;
+        size_t capacity = 0;
+        bool overflow = false;
+        uint8_t spill[4096];
+    };
+
+    static void errorExit(j_common_ptr cinfo);
+    static void outputMessage(j_common_ptr cinfo);
+    static void initDestination(j_compress_ptr cinfo);
+    static boolean emptyOutputBuffer(j_compress_ptr cinfo);
+    static void termDestination(j_compress_ptr cinfo);
+
+    jpeg_compress_struct m_cinfo;
+    ErrorManager m_error;
+    Destination m_destination;
+};
+
+// Encodes the frames of an upstream source to MJPEG on a pool of worker
+// threads and hands them on in capture order. Frames arriving while
+// every worker is busy and one frame per worker is queued are dropped.
+class MjpegEncoder : public FrameSource
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_QUALITY = 85;
+
+    // threads <= 0 picks one per core, up to four
+    explicit MjpegEncoder(std::shared_ptr<FrameSource> upstream,
+                          int quality = DEFAULT_QUALITY,
+                          int threads = 0,
+                          QObject *parent = nullptr);
+    ~MjpegEncoder();
+
+    void start() override;
+    void stop() override;
+
+    size_t width() override;
+    size_t height() override;
+    PixelFormat pixelFormat() override;
+
+    // MJPEG at every size the upstream offers in I420
+    QVector<VideoFormat> supportedFormats() override;
+    bool setFormat(const VideoFormat& format) override;
+
+    int frameRate() override;
+    bool setFrameRate(int fps) override;
+    void consumerOpened(const QString& consumer) override;
+    void consumerClosed(const QString& consumer) override;
+    bool setTransform(const FrameTransform& transform) override;
+    // Sizes the encoder's output pool, upstream frames only wait here
+    void setQueueDepth(size_t frames) override;
+    // Shared with the upstream source, frames dropped here count too
+    void setStats(std::shared_ptr<PipelineStats> stats) override;
+
+    void setQuality(int quality);
+    int quality();
+    quint64 droppedFrames();
+
+private:
+    friend class MjpegWorker;
+
+    struct Job {
+        quint64 sequence;
+        FrameRef frame;
+        VideoFormat format;
+    };
+
+    void encode(FrameRef frame);
+    void work();
+    void finish(quint64 sequence, FrameRef frame);
+    void resetPool();
+
+    std::shared_ptr<FrameSource> m_upstream;
+    std::atomic<int> m_quality;
+    std::vector<QThread*> m_workers;
+
+    QMutex m_jobMutex;
+    QWaitCondition m_jobAvailable;
+    std::deque<Job> m_jobs;
+    std::unique_ptr<FramePool> m_framePool;
+    quint64 m_nextSequence = 0;
+    quint64 m_dropped = 0;
+    bool m_quit = false;
+
+    // Finished frames wait here until all earlier ones are out
+    QMutex m_finishMutex;
+    std::map<quint64, FrameRef> m_finished;
+    quint64 m_nextEmitted = 0;
+};
+
+#endif // MJPEGENCODER_H
@@ -0,0 +1,313 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include <time.h>
+
+#include "framepool.h"
+#include "pipelinestats.h"
+#include "pixelconvert.h"
+#include "syntheticframesource.h"
+#include "v4l2loopbacksink.h"
+#include "videoformat.h"
+
+// Runs the synthetic source through CPU conversion and the loopback
+// sink as fast as it goes, one frame at a time on the calling thread,
+// and prints the results of every case as one JSON document.
+
+static std::atomic<quint64> s_allocations(0);
+
+void* operator new(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+static quint64 cpuNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (quint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static QJsonObject latencyJson(const LatencyHistogram& histogram)
+{
+    QJsonObject object;
+    object.insert(QStringLiteral("count"), (double)histogram.count());
+    object.insert(QStringLiteral("mean"), histogram.mean());
+    object.insert(QStringLiteral("p50"), (double)histogram.percentile(0.5));
+    object.insert(QStringLiteral("p99"), (double)histogram.percentile(0.99));
+    object.insert(QStringLiteral("max"), (double)histogram.max());
+    return object;
+}
+
+struct BenchSink {
+    QString mode;
+    std::unique_ptr<V4L2LoopbackSink> sink;
+    QString error;
+};
+
+static BenchSink createSink(const QString& mode, const QVector<VideoFormat>& formats)
+{
+    BenchSink result;
+    result.mode = mode;
+    if (mode == QStringLiteral("null"))
+        return result;
+
+    if (mode != QStringLiteral("write") && mode != QStringLiteral("streaming")) {
+        result.error = QStringLiteral("unknown sink mode");
+        return result;
+    }
+
+    // One device per mode, sized for every case and reformatted per case
+    const VideoFormat& first = formats.first();
+    result.sink.reset(new V4L2LoopbackSink(first.width, first.height, first.pixelFormat,
+                                           QStringLiteral("opticd bench ") + mode));
+    result.sink->setIoMode(mode == QStringLiteral("streaming") ? V4L2LoopbackSink::StreamingIo
+                                                              : V4L2LoopbackSink::WriteIo);
+    result.sink->setSupportedFormats(formats);
+    result.sink->setPacing(false);
+    result.sink->run();
+
+    if (!result.sink->isOpen())
+        result.error = QStringLiteral("no loopback device");
+    else if (mode == QStringLiteral("streaming") && result.sink->ioMode() != V4L2LoopbackSink::StreamingIo)
+        result.error = QStringLiteral("streaming I/O refused");
+    return result;
+}
+
+static QJsonObject runCase(const VideoFormat& format, BenchSink& benchSink, int frames, int warmup)
+{
+    QJsonObject result;
+    result.insert(QStringLiteral("sink"), benchSink.mode);
+    result.insert(QStringLiteral("format"), pixelFormatName(format.pixelFormat));
+    result.insert(QStringLiteral("width"), (int)format.width);
+    result.insert(QStringLiteral("height"), (int)format.height);
+
+    V4L2LoopbackSink* sink = benchSink.sink.get();
+    if (!benchSink.error.isEmpty()) {
+        result.insert(QStringLiteral("error"), benchSink.error);
+        return result;
+    }
+    if (sink && !sink->setFormat(format)) {
+        result.insert(QStringLiteral("error"), QStringLiteral("format refused"));
+        return result;
+    }
+    if (sink && benchSink.mode == QStringLiteral("streaming") && sink->ioMode() != V4L2LoopbackSink::StreamingIo) {
+        benchSink.error = QStringLiteral("streaming I/O refused");
+        result.insert(QStringLiteral("error"), benchSink.error);
+        return result;
+    }
+
+    // Formats the camera converts on the CPU start out as RGBA, the
+    // others are painted directly
+    const bool convert = pixelConvertSupports(PixelFormat::Rgba32, format.pixelFormat);
+    result.insert(QStringLiteral("conversion"), convert ? pixelConvertIsaName(pixelConvertIsa())
+                                                        : QStringLiteral("none"));
+
+    SyntheticFrameSource source(format.width, format.height, 30,
+                                convert ? PixelFormat::Rgba32 : format.pixelFormat);
+    FramePool convertedPool(format.frameSize());
+    quint64 delivered = 0;
+    quint64 failed = 0;
+
+    QObject::connect(&source, &FrameSource::captured, [&](FrameRef frame) {
+        if (convert) {
+            FrameRef converted = convertedPool.acquire();
+            if (converted.isNull()
+                    || !pixelConvert(frame.data(), PixelFormat::Rgba32, converted.data(), format.pixelFormat,
+                                     format.width, format.height)) {
+                ++failed;
+                return;
+            }
+            converted.copyTiming(frame);
+            frame = converted;
+        }
+
+        if (sink)
+            sink->pushCapture(frame);
+        ++delivered;
+    });
+
+    for (int i = 0; i < warmup; i++)
+        source.requestFrame();
+
+    // Fresh counters so the warmup doesn't show
+    auto stats = std::make_shared<PipelineStats>(QStringLiteral("bench"));
+    source.setStats(stats);
+    if (sink)
+        sink->setStats(stats);
+    delivered = 0;
+    failed = 0;
+
+    LatencyHistogram latency;
+    const quint64 allocationsBefore = s_allocations.load();
+    const quint64 cpuBefore = cpuNanoseconds();
+    const quint64 wallBefore = monotonicNanoseconds();
+
+    for (int i = 0; i < frames; i++) {
+        const quint64 start = monotonicNanoseconds();
+        source.requestFrame();
+        latency.record((monotonicNanoseconds() - start) / 1000);
+    }
+
+    const double wall = (monotonicNanoseconds() - wallBefore) / 1e9;
+    const double cpu = (cpuNanoseconds() - cpuBefore) / 1e3;
+    const quint64 allocations = s_allocations.load() - allocationsBefore;
+
+    if (sink)
+        sink->setStats(nullptr);
+
+    const quint64 written = sink ? stats->written.load() : delivered;
+    result.insert(QStringLiteral("frames"), (double)written);
+    result.insert(QStringLiteral("dropped"), (double)(stats->dropped.load() + failed));
+    result.insert(QStringLiteral("short_writes"), (double)stats->shortWrites.load());
+    result.insert(QStringLiteral("fps"), wall > 0 ? written / wall : 0.0);
+    result.insert(QStringLiteral("cpu_us_per_frame"), cpu / frames);
+    result.insert(QStringLiteral("allocations_per_frame"), (double)allocations / frames);
+    result.insert(QStringLiteral("latency_us"), latencyJson(latency));
+    if (sink)
+        result.insert(QStringLiteral("write_us"), latencyJson(stats->histogram(PipelineStats::Write)));
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    qRegisterMetaType<FrameRef>("FrameRef");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Throughput benchmark of the opticd frame pipeline, prints JSON");
+    parser.addHelpOption();
+    const QCommandLineOption sizesOption("sizes",
+                                         "Comma separated frame sizes.",
+                                         "WIDTHxHEIGHT,...", "640x480,1280x720,1920x1080");
+    const QCommandLineOption formatsOption("formats",
+                                           "Comma separated pixel formats.",
+                                           "formats", "rgba,rgb24,bgr24,yuyv,nv12,nv21,i420");
+    const QCommandLineOption sinksOption("sinks",
+                                         "Comma separated sinks: null, write or streaming. The last two "
+                                         "need v4l2loopback and permission to add devices.",
+                                         "sinks", "null,write,streaming");
+    const QCommandLineOption framesOption("frames",
+                                          "Frames measured per case.",
+                                          "count", "300");
+    const QCommandLineOption warmupOption("warmup",
+                                          "Frames run per case before measuring.",
+                                          "count", "10");
+    const QCommandLineOption isaOption("isa",
+                                       "Conversion kernels: scalar, ssse3, avx2, neon or auto.",
+                                       "isa", "auto");
+    const QCommandLineOption outputOption("output",
+                                          "File to write the JSON to instead of stdout.",
+                                          "path");
+    parser.addOption(sizesOption);
+    parser.addOption(formatsOption);
+    parser.addOption(sinksOption);
+    parser.addOption(framesOption);
+    parser.addOption(warmupOption);
+    parser.addOption(isaOption);
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    const int frames = parser.value(framesOption).toInt();
+    const int warmup = parser.value(warmupOption).toInt();
+    if (frames <= 0 || warmup < 0) {
+        qFatal("Invalid frame count");
+        return 1;
+    }
+
+    if (parser.value(isaOption) != QStringLiteral("auto")) {
+        bool found = false;
+        for (PixelConvertIsa isa : { PixelConvertIsa::Scalar, PixelConvertIsa::Ssse3,
+                                     PixelConvertIsa::Avx2, PixelConvertIsa::Neon }) {
+            if (pixelConvertIsaName(isa) == parser.value(isaOption))
+                found = pixelConvertSetIsa(isa);
+        }
+        if (!found) {
+            qFatal("Conversion kernels not available: %s", parser.value(isaOption).toUtf8().data());
+            return 1;
+        }
+    }
+
+    QVector<VideoFormat> formats;
+    for (const QString& size : parser.value(sizesOption).split(QLatin1Char(','))) {
+        size_t width, height;
+        if (!parseFrameSize(size, &width, &height)) {
+            qFatal("Invalid frame size: %s", size.toUtf8().data());
+            return 1;
+        }
+
+        for (const QString& name : parser.value(formatsOption).split(QLatin1Char(','))) {
+            PixelFormat pixelFormat;
+            if (!parsePixelFormat(name, &pixelFormat) || pixelFormatIsCompressed(pixelFormat)) {
+                qFatal("Unsupported pixel format: %s", name.toUtf8().data());
+                return 1;
+            }
+            if (pixelFormatSupportsSize(pixelFormat, width, height))
+                formats.append(VideoFormat(pixelFormat, width, height));
+        }
+    }
+    if (formats.isEmpty()) {
+        qFatal("No format fits the given sizes");
+        return 1;
+    }
+
+    QJsonArray results;
+    for (const QString& mode : parser.value(sinksOption).split(QLatin1Char(','))) {
+        BenchSink sink = createSink(mode, formats);
+        for (const VideoFormat& format : formats) {
+            const QJsonObject result = runCase(format, sink, frames, warmup);
+            qInfo() << mode << format << result.value(QStringLiteral("fps")).toDouble() << "fps";
+            results.append(result);
+        }
+    }
+
+    QJsonObject report;
+    report.insert(QStringLiteral("isa"), pixelConvertIsaName(pixelConvertIsa()));
+    report.insert(QStringLiteral("frames"), frames);
+    report.insert(QStringLiteral("results"), results);
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    QFile output;
+    bool opened;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        opened = output.open(QIODevice::WriteOnly);
+    } else {
+        opened = output.open(stdout, QIODevice::WriteOnly);
+    }
+    if (!opened || output.write(json) != json.size()) {
+        qFatal("Failed to write results");
+        return 1;
+    }
+    return 0;
+}
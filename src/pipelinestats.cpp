@@ -0,0 +1,200 @@
+#include "pipelinestats.h"
+
+#include <algorithm>
+
+#include <time.h>
+
+// Weight of the newest interval in the smoothed frame rate, out of 16
+static const quint64 INTERVAL_WEIGHT = 2;
+
+quint64 monotonicNanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (quint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+LatencyHistogram::LatencyHistogram() :
+    m_count(0),
+    m_sum(0),
+    m_max(0)
+{
+    for (std::atomic<quint64>& bucket : this->m_buckets)
+        bucket = 0;
+}
+
+int LatencyHistogram::bucketOf(quint64 value)
+{
+    if (value < LINEAR_BUCKETS)
+        return value;
+
+    // Exponent of the highest set bit, then the next bits below it
+    const int exponent = 63 - __builtin_clzll(value);
+    const int sub = (value >> (exponent - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+    return LINEAR_BUCKETS + (exponent - 4) * (1 << SUB_BUCKET_BITS) + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int bucket)
+{
+    if (bucket < LINEAR_BUCKETS)
+        return bucket;
+
+    const int exponent = (bucket - LINEAR_BUCKETS) / (1 << SUB_BUCKET_BITS) + 4;
+    const int sub = (bucket - LINEAR_BUCKETS) % (1 << SUB_BUCKET_BITS);
+    const quint64 step = 1ULL << (exponent - SUB_BUCKET_BITS);
+    return (1ULL << exponent) + (sub + 1) * step - 1;
+}
+
+void LatencyHistogram::record(quint64 microseconds)
+{
+    this->m_buckets[bucketOf(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    this->m_count.fetch_add(1, std::memory_order_relaxed);
+    this->m_sum.fetch_add(microseconds, std::memory_order_relaxed);
+
+    quint64 max = this->m_max.load(std::memory_order_relaxed);
+    while (microseconds > max
+           && !this->m_max.compare_exchange_weak(max, microseconds, std::memory_order_relaxed)) {
+    }
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return this->m_count.load(std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::max() const
+{
+    return this->m_max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    const quint64 count = this->count();
+    return count ? (double)this->m_sum.load(std::memory_order_relaxed) / count : 0.0;
+}
+
+quint64 LatencyHistogram::percentile(double fraction) const
+{
+    // Buckets keep counting while being read, so go by their own sum
+    quint64 counts[BUCKETS];
+    quint64 total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = this->m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return 0;
+
+    const quint64 rank = std::max<quint64>(1, (quint64)(fraction * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), this->max());
+    }
+    return this->max();
+}
+
+PipelineStats::PipelineStats(const QString& name) :
+    produced(0),
+    dropped(0),
+    repeated(0),
+    written(0),
+    shortWrites(0),
+    queueDropped(0),
+    late(0),
+    m_name(name),
+    m_lastWrite(0),
+    m_frameInterval(0)
+{
+}
+
+QString PipelineStats::name() const
+{
+    return this->m_name;
+}
+
+void PipelineStats::setBufferingProfile(const QString& profile)
+{
+    this->m_bufferingProfile = profile;
+}
+
+QString PipelineStats::bufferingProfile() const
+{
+    return this->m_bufferingProfile;
+}
+
+QString PipelineStats::stageName(Stage stage)
+{
+    switch (stage) {
+    case Callback:
+        return QStringLiteral("callback");
+    case UpdateTexture:
+        return QStringLiteral("update_texture");
+    case ReadPixels:
+        return QStringLiteral("read_pixels");
+    case Write:
+        return QStringLiteral("write");
+    case StageCount:
+        break;
+    }
+    return QString();
+}
+
+void PipelineStats::record(Stage stage, quint64 startNanoseconds)
+{
+    const quint64 now = monotonicNanoseconds();
+    this->m_histograms[stage].record(now > startNanoseconds ? (now - startNanoseconds) / 1000 : 0);
+}
+
+const LatencyHistogram& PipelineStats::histogram(Stage stage) const
+{
+    return this->m_histograms[stage];
+}
+
+void PipelineStats::frameWritten()
+{
+    this->written.fetch_add(1, std::memory_order_relaxed);
+
+    const quint64 now = monotonicNanoseconds();
+    const quint64 last = this->m_lastWrite.exchange(now, std::memory_order_relaxed);
+    if (last == 0)
+        return;
+
+    const quint64 interval = now - last;
+    const quint64 smoothed = this->m_frameInterval.load(std::memory_order_relaxed);
+    this->m_frameInterval.store(smoothed == 0 ? interval
+                                              : (smoothed * (16 - INTERVAL_WEIGHT) + interval * INTERVAL_WEIGHT) / 16,
+                                std::memory_order_relaxed);
+}
+
+double PipelineStats::framesPerSecond() const
+{
+    const quint64 interval = this->m_frameInterval.load(std::memory_order_relaxed);
+    return interval ? 1e9 / interval : 0.0;
+}
+
+QVariantMap PipelineStats::snapshot() const
+{
+    QVariantMap map;
+    map.insert(QStringLiteral("frames_produced"), this->produced.load());
+    map.insert(QStringLiteral("frames_dropped"), this->dropped.load());
+    map.insert(QStringLiteral("frames_repeated"), this->repeated.load());
+    map.insert(QStringLiteral("frames_written"), this->written.load());
+    map.insert(QStringLiteral("short_writes"), this->shortWrites.load());
+    map.insert(QStringLiteral("frames_queue_dropped"), this->queueDropped.load());
+    map.insert(QStringLiteral("frames_late"), this->late.load());
+    map.insert(QStringLiteral("buffering_profile"), this->m_bufferingProfile);
+    map.insert(QStringLiteral("fps"), framesPerSecond());
+
+    for (int i = 0; i < StageCount; i++) {
+        const QString prefix = stageName(Stage(i)) + QStringLiteral("_");
+        const LatencyHistogram& histogram = this->m_histograms[i];
+        map.insert(prefix + QStringLiteral("count"), histogram.count());
+        map.insert(prefix + QStringLiteral("mean_us"), histogram.mean());
+        map.insert(prefix + QStringLiteral("p50_us"), histogram.percentile(0.5));
+        map.insert(prefix + QStringLiteral("p99_us"), histogram.percentile(0.99));
+        map.insert(prefix + QStringLiteral("max_us"), histogram.max());
+    }
+    return map;
+}
@@ -0,0 +1,123 @@
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include <QString>
+#include <QVariantMap>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Monotonic clock in nanoseconds, for timing pipeline stages
+quint64 monotonicNanoseconds();
+
+// Latency distribution in microseconds with log-linear buckets, exact
+// below 16us and within 12.5% above. Recording is lock-free and may
+// happen from any number of threads while another one reads.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(quint64 microseconds);
+
+    quint64 count() const;
+    quint64 max() const;
+    double mean() const;
+    // Upper bound of the bucket holding the given fraction of samples
+    quint64 percentile(double fraction) const;
+
+private:
+    static const int LINEAR_BUCKETS = 16;
+    static const int SUB_BUCKET_BITS = 3;
+    static const int BUCKETS = LINEAR_BUCKETS + (64 - 4) * (1 << SUB_BUCKET_BITS);
+
+    static int bucketOf(quint64 value);
+    static quint64 bucketUpperBound(int bucket);
+
+    std::atomic<quint64> m_buckets[BUCKETS];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum;
+    std::atomic<quint64> m_max;
+};
+
+// Timings and frame counters of one camera's pipeline, shared by its
+// source and sink
+class PipelineStats
+{
+public:
+    enum Stage {
+        // Frame-available callback until the camera thread handles it
+        Callback,
+        // android_camera_update_preview_texture()
+        UpdateTexture,
+        // glReadPixels() or collecting a pixel pack buffer
+        ReadPixels,
+        // write() or VIDIOC_QBUF on the loopback device
+        Write,
+        StageCount
+    };
+
+    explicit PipelineStats(const QString& name);
+
+    QString name() const;
+    static QString stageName(Stage stage);
+
+    // Buffering profile of the device fed, set before frames flow
+    void setBufferingProfile(const QString& profile);
+    QString bufferingProfile() const;
+
+    void record(Stage stage, quint64 startNanoseconds);
+    const LatencyHistogram& histogram(Stage stage) const;
+
+    // Called once per frame that made it to the device, single writer
+    void frameWritten();
+
+    std::atomic<quint64> produced;
+    std::atomic<quint64> dropped;
+    std::atomic<quint64> repeated;
+    std::atomic<quint64> written;
+    std::atomic<quint64> shortWrites;
+    // Pushed out of or refused by a full writer queue, also in dropped
+    std::atomic<quint64> queueDropped;
+    // Written later than the buffering profile allows after capture
+    std::atomic<quint64> late;
+
+    // Smoothed over the last few frames written
+    double framesPerSecond() const;
+
+    // Flat snapshot for export, latencies in microseconds
+    QVariantMap snapshot() const;
+
+private:
+    QString m_name;
+    QString m_bufferingProfile;
+    LatencyHistogram m_histograms[StageCount];
+    std::atomic<quint64> m_lastWrite;
+    std::atomic<quint64> m_frameInterval;
+};
+
+// Times a stage from construction to destruction, no-op without stats
+class StageTimer
+{
+public:
+    StageTimer(const std::shared_ptr<PipelineStats>& stats, PipelineStats::Stage stage) :
+        m_stats(stats.get()),
+        m_stage(stage),
+        m_start(m_stats ? monotonicNanoseconds() : 0) {}
+    ~StageTimer()
+    {
+        if (this->m_stats)
+            this->m_stats->record(this->m_stage, this->m_start);
+    }
+
+private:
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    PipelineStats* m_stats;
+    PipelineStats::Stage m_stage;
+    quint64 m_start;
+};
+
+#endif // PIPELINESTATS_H
@@ -0,0 +1,358 @@
+#include "pixelconvert.h"
+#include "pixelconvert_p.h"
+
+#include <QDebug>
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__arm__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Scalar reference, every SIMD kernel has to match these bit for bit.
+
+static void rgbaToRgb24Row(const uint8_t* rgba, uint8_t* rgb, size_t width)
+{
+    for (size_t x = 0; x < width; x++) {
+        rgb[x * 3] = rgba[x * 4];
+        rgb[x * 3 + 1] = rgba[x * 4 + 1];
+        rgb[x * 3 + 2] = rgba[x * 4 + 2];
+    }
+}
+
+static void rgbaToBgr24Row(const uint8_t* rgba, uint8_t* bgr, size_t width)
+{
+    for (size_t x = 0; x < width; x++) {
+        bgr[x * 3] = rgba[x * 4 + 2];
+        bgr[x * 3 + 1] = rgba[x * 4 + 1];
+        bgr[x * 3 + 2] = rgba[x * 4];
+    }
+}
+
+static void rgbaToYRow(const uint8_t* rgba, uint8_t* y, size_t width)
+{
+    for (size_t x = 0; x < width; x++)
+        y[x] = pixelConvertY(rgba[x * 4], rgba[x * 4 + 1], rgba[x * 4 + 2]);
+}
+
+// Chroma of horizontal pixel pairs, sampled from the pair's average
+static void rgbaToYuyvRow(const uint8_t* rgba, uint8_t* yuyv, size_t width)
+{
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        const uint8_t* p = rgba + x * 4;
+        const int r = (p[0] + p[4] + 1) >> 1;
+        const int g = (p[1] + p[5] + 1) >> 1;
+        const int b = (p[2] + p[6] + 1) >> 1;
+
+        yuyv[x * 2] = pixelConvertY(p[0], p[1], p[2]);
+        yuyv[x * 2 + 1] = pixelConvertU(r, g, b);
+        yuyv[x * 2 + 2] = pixelConvertY(p[4], p[5], p[6]);
+        yuyv[x * 2 + 3] = pixelConvertV(r, g, b);
+    }
+}
+
+// Chroma of 2x2 blocks, sampled from the block's average
+static inline void averageBlock(const uint8_t* p0, const uint8_t* p1, int* r, int* g, int* b)
+{
+    *r = (p0[0] + p0[4] + p1[0] + p1[4] + 2) >> 2;
+    *g = (p0[1] + p0[5] + p1[1] + p1[5] + 2) >> 2;
+    *b = (p0[2] + p0[6] + p1[2] + p1[6] + 2) >> 2;
+}
+
+static void rgbaToUVPlanarRow(const uint8_t* rgba0, const uint8_t* rgba1,
+                              uint8_t* u, uint8_t* v, size_t width)
+{
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        int r, g, b;
+        averageBlock(rgba0 + x * 4, rgba1 + x * 4, &r, &g, &b);
+        u[x / 2] = pixelConvertU(r, g, b);
+        v[x / 2] = pixelConvertV(r, g, b);
+    }
+}
+
+static void rgbaToUVInterleavedRow(const uint8_t* rgba0, const uint8_t* rgba1,
+                                   uint8_t* uv, size_t width)
+{
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        int r, g, b;
+        averageBlock(rgba0 + x * 4, rgba1 + x * 4, &r, &g, &b);
+        uv[x] = pixelConvertU(r, g, b);
+        uv[x + 1] = pixelConvertV(r, g, b);
+    }
+}
+
+static void nv21ToRgb24Row(const uint8_t* y, const uint8_t* vu, uint8_t* rgb, size_t width)
+{
+    for (size_t x = 0; x < width; x++) {
+        const uint8_t* chroma = vu + (x & ~size_t(1));
+        pixelConvertYuvToRgb(y[x], chroma[1], chroma[0], &rgb[x * 3], &rgb[x * 3 + 1], &rgb[x * 3 + 2]);
+    }
+}
+
+static void nv21ToBgr24Row(const uint8_t* y, const uint8_t* vu, uint8_t* bgr, size_t width)
+{
+    for (size_t x = 0; x < width; x++) {
+        const uint8_t* chroma = vu + (x & ~size_t(1));
+        pixelConvertYuvToRgb(y[x], chroma[1], chroma[0], &bgr[x * 3 + 2], &bgr[x * 3 + 1], &bgr[x * 3]);
+    }
+}
+
+static void nv21ToYuyvRow(const uint8_t* y, const uint8_t* vu, uint8_t* yuyv, size_t width)
+{
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        yuyv[x * 2] = y[x];
+        yuyv[x * 2 + 1] = vu[x + 1];
+        yuyv[x * 2 + 2] = y[x + 1];
+        yuyv[x * 2 + 3] = vu[x];
+    }
+}
+
+static void vuToUVRow(const uint8_t* vu, uint8_t* uv, size_t width)
+{
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        uv[x] = vu[x + 1];
+        uv[x + 1] = vu[x];
+    }
+}
+
+static void vuToPlanarRow(const uint8_t* vu, uint8_t* u, uint8_t* v, size_t width)
+{
+    for (size_t x = 0; x + 1 < width; x += 2) {
+        u[x / 2] = vu[x + 1];
+        v[x / 2] = vu[x];
+    }
+}
+
+const PixelConvertKernels pixelConvertScalarKernels = {
+    rgbaToRgb24Row,
+    rgbaToBgr24Row,
+    rgbaToYRow,
+    rgbaToYuyvRow,
+    rgbaToUVPlanarRow,
+    rgbaToUVInterleavedRow,
+    nv21ToRgb24Row,
+    nv21ToBgr24Row,
+    nv21ToYuyvRow,
+    vuToUVRow,
+    vuToPlanarRow,
+};
+
+static const PixelConvertKernels* kernelsFor(PixelConvertIsa isa)
+{
+    switch (isa) {
+    case PixelConvertIsa::Scalar:
+        return &pixelConvertScalarKernels;
+    case PixelConvertIsa::Ssse3:
+#ifdef PIXELCONVERT_HAVE_X86
+        return &pixelConvertSsse3Kernels;
+#else
+        return nullptr;
+#endif
+    case PixelConvertIsa::Avx2:
+#ifdef PIXELCONVERT_HAVE_X86
+        return &pixelConvertAvx2Kernels;
+#else
+        return nullptr;
+#endif
+    case PixelConvertIsa::Neon:
+#ifdef PIXELCONVERT_HAVE_NEON
+        return &pixelConvertNeonKernels;
+#else
+        return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+bool pixelConvertIsaAvailable(PixelConvertIsa isa)
+{
+    if (!kernelsFor(isa))
+        return false;
+
+    switch (isa) {
+    case PixelConvertIsa::Scalar:
+        return true;
+#ifdef PIXELCONVERT_HAVE_X86
+    case PixelConvertIsa::Ssse3:
+        return __builtin_cpu_supports("ssse3");
+    case PixelConvertIsa::Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef PIXELCONVERT_HAVE_NEON
+    case PixelConvertIsa::Neon:
+#if defined(__aarch64__)
+        return true;
+#else
+        return getauxval(AT_HWCAP) & HWCAP_NEON;
+#endif
+#endif
+    default:
+        return false;
+    }
+}
+
+static PixelConvertIsa detectIsa()
+{
+    static const PixelConvertIsa preferred[] = {
+        PixelConvertIsa::Avx2,
+        PixelConvertIsa::Ssse3,
+        PixelConvertIsa::Neon,
+    };
+
+    for (const PixelConvertIsa isa : preferred) {
+        if (pixelConvertIsaAvailable(isa))
+            return isa;
+    }
+    return PixelConvertIsa::Scalar;
+}
+
+static std::atomic<int> s_isa { -1 };
+
+PixelConvertIsa pixelConvertIsa()
+{
+    int isa = s_isa.load(std::memory_order_relaxed);
+    if (isa < 0) {
+        isa = static_cast<int>(detectIsa());
+        s_isa.store(isa, std::memory_order_relaxed);
+        qInfo() << "Pixel conversion using" << pixelConvertIsaName(static_cast<PixelConvertIsa>(isa));
+    }
+    return static_cast<PixelConvertIsa>(isa);
+}
+
+bool pixelConvertSetIsa(PixelConvertIsa isa)
+{
+    if (!pixelConvertIsaAvailable(isa))
+        return false;
+
+    s_isa.store(static_cast<int>(isa), std::memory_order_relaxed);
+    return true;
+}
+
+QString pixelConvertIsaName(PixelConvertIsa isa)
+{
+    switch (isa) {
+    case PixelConvertIsa::Scalar:
+        return QStringLiteral("scalar");
+    case PixelConvertIsa::Ssse3:
+        return QStringLiteral("ssse3");
+    case PixelConvertIsa::Avx2:
+        return QStringLiteral("avx2");
+    case PixelConvertIsa::Neon:
+        return QStringLiteral("neon");
+    }
+    return QString();
+}
+
+bool pixelConvertSupports(PixelFormat from, PixelFormat to)
+{
+    if (from != PixelFormat::Rgba32 && from != PixelFormat::Nv21)
+        return false;
+
+    switch (to) {
+    case PixelFormat::Rgb24:
+    case PixelFormat::Bgr24:
+    case PixelFormat::Yuyv:
+    case PixelFormat::Nv12:
+    case PixelFormat::I420:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool pixelConvert(const uint8_t* source, PixelFormat from,
+                  uint8_t* destination, PixelFormat to,
+                  size_t width, size_t height)
+{
+    if (!pixelConvertSupports(from, to) || width == 0 || height == 0)
+        return false;
+
+    // Kernels work on whole chroma samples
+    const bool verticalChroma = from == PixelFormat::Nv21 || to == PixelFormat::Nv12 || to == PixelFormat::I420;
+    const bool horizontalChroma = verticalChroma || to == PixelFormat::Yuyv;
+    if ((horizontalChroma && width % 2) || (verticalChroma && height % 2))
+        return false;
+
+    const PixelConvertKernels* k = kernelsFor(pixelConvertIsa());
+    const size_t lumaSize = width * height;
+
+    if (from == PixelFormat::Rgba32) {
+        const size_t stride = width * 4;
+
+        for (size_t row = 0; row < height; row++) {
+            const uint8_t* line = source + row * stride;
+
+            switch (to) {
+            case PixelFormat::Rgb24:
+                k->rgbaToRgb24Row(line, destination + row * width * 3, width);
+                break;
+            case PixelFormat::Bgr24:
+                k->rgbaToBgr24Row(line, destination + row * width * 3, width);
+                break;
+            case PixelFormat::Yuyv:
+                k->rgbaToYuyvRow(line, destination + row * width * 2, width);
+                break;
+            case PixelFormat::Nv12:
+                k->rgbaToYRow(line, destination + row * width, width);
+                if (row % 2)
+                    k->rgbaToUVInterleavedRow(line - stride, line,
+                                              destination + lumaSize + row / 2 * width, width);
+                break;
+            case PixelFormat::I420:
+                k->rgbaToYRow(line, destination + row * width, width);
+                if (row % 2)
+                    k->rgbaToUVPlanarRow(line - stride, line,
+                                         destination + lumaSize + row / 2 * (width / 2),
+                                         destination + lumaSize * 5 / 4 + row / 2 * (width / 2),
+                                         width);
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // NV21: full resolution Y plane, then one VU row per two Y rows
+    const uint8_t* vuPlane = source + lumaSize;
+
+    switch (to) {
+    case PixelFormat::Nv12:
+        memcpy(destination, source, lumaSize);
+        for (size_t row = 0; row < height / 2; row++)
+            k->vuToUVRow(vuPlane + row * width, destination + lumaSize + row * width, width);
+        return true;
+    case PixelFormat::I420:
+        memcpy(destination, source, lumaSize);
+        for (size_t row = 0; row < height / 2; row++)
+            k->vuToPlanarRow(vuPlane + row * width,
+                             destination + lumaSize + row * (width / 2),
+                             destination + lumaSize * 5 / 4 + row * (width / 2),
+                             width);
+        return true;
+    default:
+        break;
+    }
+
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t* luma = source + row * width;
+        const uint8_t* chroma = vuPlane + row / 2 * width;
+
+        switch (to) {
+        case PixelFormat::Rgb24:
+            k->nv21ToRgb24Row(luma, chroma, destination + row * width * 3, width);
+            break;
+        case PixelFormat::Bgr24:
+            k->nv21ToBgr24Row(luma, chroma, destination + row * width * 3, width);
+            break;
+        case PixelFormat::Yuyv:
+            k->nv21ToYuyvRow(luma, chroma, destination + row * width * 2, width);
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef PIXELCONVERT_H
+#define PIXELCONVERT_H
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "videoformat.h"
+
+// CPU pixel format conversion, for when the GPU can't convert.
+// Kernels are picked at runtime for the best instruction set the CPU
+// supports and are bit-exact with the scalar reference.
+
+enum class PixelConvertIsa {
+    Scalar,
+    Ssse3,
+    Avx2,
+    Neon
+};
+
+// Whether pixelConvert() handles the pair, RGBA32 and NV21 are the inputs
+bool pixelConvertSupports(PixelFormat from, PixelFormat to);
+
+// Converts a tightly packed frame, returns false for unsupported pairs
+// or sizes that don't fit the formats' subsampling
+bool pixelConvert(const uint8_t* source, PixelFormat from,
+                  uint8_t* destination, PixelFormat to,
+                  size_t width, size_t height);
+
+PixelConvertIsa pixelConvertIsa();
+bool pixelConvertIsaAvailable(PixelConvertIsa isa);
+// Overrides the runtime choice, for comparisons against the reference
+bool pixelConvertSetIsa(PixelConvertIsa isa);
+QString pixelConvertIsaName(PixelConvertIsa isa);
+
+#endif // PIXELCONVERT_H
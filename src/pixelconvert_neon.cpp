@@ -0,0 +1,273 @@
+#include "pixelconvert_p.h"
+
+#ifdef PIXELCONVERT_HAVE_NEON
+
+#include <arm_neon.h>
+
+// NEON kernels, 16 pixels per iteration. On 32 bit ARM this file is
+// built with -mfpu=neon and only selected when the CPU reports NEON.
+//
+// Luma fits in unsigned 16 bit and chroma in signed 16 bit, the rounding
+// shifts (vrshr) add half before shifting exactly like the scalar code.
+// Leftover pixels at the end of a row go through the scalar kernels.
+
+static const PixelConvertKernels& scalar = pixelConvertScalarKernels;
+
+static void rgbaToRgb24RowNeon(const uint8_t* rgba, uint8_t* rgb, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(rgba + x * 4);
+        uint8x16x3_t out;
+        out.val[0] = pixels.val[0];
+        out.val[1] = pixels.val[1];
+        out.val[2] = pixels.val[2];
+        vst3q_u8(rgb + x * 3, out);
+    }
+
+    scalar.rgbaToRgb24Row(rgba + x * 4, rgb + x * 3, width - x);
+}
+
+static void rgbaToBgr24RowNeon(const uint8_t* rgba, uint8_t* bgr, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(rgba + x * 4);
+        uint8x16x3_t out;
+        out.val[0] = pixels.val[2];
+        out.val[1] = pixels.val[1];
+        out.val[2] = pixels.val[0];
+        vst3q_u8(bgr + x * 3, out);
+    }
+
+    scalar.rgbaToBgr24Row(rgba + x * 4, bgr + x * 3, width - x);
+}
+
+static inline uint8x8_t luma8(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+    uint16x8_t sum = vmull_u8(r, vdup_n_u8(66));
+    sum = vmlal_u8(sum, g, vdup_n_u8(129));
+    sum = vmlal_u8(sum, b, vdup_n_u8(25));
+    return vadd_u8(vrshrn_n_u16(sum, 8), vdup_n_u8(16));
+}
+
+static inline uint8x16_t luma16(const uint8x16x4_t& pixels)
+{
+    const uint8x8_t lo = luma8(vget_low_u8(pixels.val[0]), vget_low_u8(pixels.val[1]), vget_low_u8(pixels.val[2]));
+    const uint8x8_t hi = luma8(vget_high_u8(pixels.val[0]), vget_high_u8(pixels.val[1]), vget_high_u8(pixels.val[2]));
+    return vcombine_u8(lo, hi);
+}
+
+static void rgbaToYRowNeon(const uint8_t* rgba, uint8_t* y, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16)
+        vst1q_u8(y + x, luma16(vld4q_u8(rgba + x * 4)));
+
+    scalar.rgbaToYRow(rgba + x * 4, y + x, width - x);
+}
+
+// U and V of 8 averaged pixels
+static inline void chroma8(uint16x8_t r, uint16x8_t g, uint16x8_t b, uint8x8_t* u, uint8x8_t* v)
+{
+    const int16x8_t rs = vreinterpretq_s16_u16(r);
+    const int16x8_t gs = vreinterpretq_s16_u16(g);
+    const int16x8_t bs = vreinterpretq_s16_u16(b);
+    const int16x8_t offset = vdupq_n_s16(128);
+
+    int16x8_t su = vmulq_n_s16(rs, -38);
+    su = vmlaq_n_s16(su, gs, -74);
+    su = vmlaq_n_s16(su, bs, 112);
+    *u = vqmovun_s16(vaddq_s16(vrshrq_n_s16(su, 8), offset));
+
+    int16x8_t sv = vmulq_n_s16(rs, 112);
+    sv = vmlaq_n_s16(sv, gs, -94);
+    sv = vmlaq_n_s16(sv, bs, -18);
+    *v = vqmovun_s16(vaddq_s16(vrshrq_n_s16(sv, 8), offset));
+}
+
+static void rgbaToYuyvRowNeon(const uint8_t* rgba, uint8_t* yuyv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(rgba + x * 4);
+
+        // Pairwise sums, then (a + b + 1) >> 1
+        const uint16x8_t r = vrshrq_n_u16(vpaddlq_u8(pixels.val[0]), 1);
+        const uint16x8_t g = vrshrq_n_u16(vpaddlq_u8(pixels.val[1]), 1);
+        const uint16x8_t b = vrshrq_n_u16(vpaddlq_u8(pixels.val[2]), 1);
+        uint8x8_t u, v;
+        chroma8(r, g, b, &u, &v);
+
+        const uint8x8x2_t uv = vzip_u8(u, v);
+        uint8x16x2_t out;
+        out.val[0] = luma16(pixels);
+        out.val[1] = vcombine_u8(uv.val[0], uv.val[1]);
+        vst2q_u8(yuyv + x * 2, out);
+    }
+
+    scalar.rgbaToYuyvRow(rgba + x * 4, yuyv + x * 2, width - x);
+}
+
+// U and V of the 2x2 blocks covering 16 pixels of two rows
+static inline void chromaBlock16(const uint8_t* rgba0, const uint8_t* rgba1, uint8x8_t* u, uint8x8_t* v)
+{
+    const uint8x16x4_t p0 = vld4q_u8(rgba0);
+    const uint8x16x4_t p1 = vld4q_u8(rgba1);
+
+    // Pairwise sums of both rows, then (sum + 2) >> 2
+    const uint16x8_t r = vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(p0.val[0]), p1.val[0]), 2);
+    const uint16x8_t g = vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(p0.val[1]), p1.val[1]), 2);
+    const uint16x8_t b = vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(p0.val[2]), p1.val[2]), 2);
+    chroma8(r, g, b, u, v);
+}
+
+static void rgbaToUVPlanarRowNeon(const uint8_t* rgba0, const uint8_t* rgba1,
+                                  uint8_t* u, uint8_t* v, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x8_t u8, v8;
+        chromaBlock16(rgba0 + x * 4, rgba1 + x * 4, &u8, &v8);
+        vst1_u8(u + x / 2, u8);
+        vst1_u8(v + x / 2, v8);
+    }
+
+    scalar.rgbaToUVPlanarRow(rgba0 + x * 4, rgba1 + x * 4, u + x / 2, v + x / 2, width - x);
+}
+
+static void rgbaToUVInterleavedRowNeon(const uint8_t* rgba0, const uint8_t* rgba1,
+                                       uint8_t* uv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x8x2_t out;
+        chromaBlock16(rgba0 + x * 4, rgba1 + x * 4, &out.val[0], &out.val[1]);
+        vst2_u8(uv + x, out);
+    }
+
+    scalar.rgbaToUVInterleavedRow(rgba0 + x * 4, rgba1 + x * 4, uv + x, width - x);
+}
+
+// (sum + 128) >> 8 of two halves, saturated to bytes
+static inline uint8x8_t descaleClamp(int32x4_t lo, int32x4_t hi)
+{
+    return vqmovn_u16(vcombine_u16(vqrshrun_n_s32(lo, 8), vqrshrun_n_s32(hi, 8)));
+}
+
+// 8 pixels from Y and per pixel V and U to R, G and B
+static inline void yuv8ToRgb(uint8x8_t y, uint8x8_t v, uint8x8_t u, uint8x8_t* r, uint8x8_t* g, uint8x8_t* b)
+{
+    const int16x8_t c = vreinterpretq_s16_u16(vsubl_u8(y, vdup_n_u8(16)));
+    const int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(u, vdup_n_u8(128)));
+    const int16x8_t e = vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(128)));
+
+    const int32x4_t cLo = vmull_n_s16(vget_low_s16(c), 298);
+    const int32x4_t cHi = vmull_n_s16(vget_high_s16(c), 298);
+
+    *r = descaleClamp(vmlal_n_s16(cLo, vget_low_s16(e), 409),
+                      vmlal_n_s16(cHi, vget_high_s16(e), 409));
+    *b = descaleClamp(vmlal_n_s16(cLo, vget_low_s16(d), 516),
+                      vmlal_n_s16(cHi, vget_high_s16(d), 516));
+
+    int32x4_t gLo = vmlal_n_s16(cLo, vget_low_s16(d), -100);
+    int32x4_t gHi = vmlal_n_s16(cHi, vget_high_s16(d), -100);
+    gLo = vmlal_n_s16(gLo, vget_low_s16(e), -208);
+    gHi = vmlal_n_s16(gHi, vget_high_s16(e), -208);
+    *g = descaleClamp(gLo, gHi);
+}
+
+// 16 NV21 pixels to 16 bytes each of R, G and B
+static inline void yuv16ToRgb(const uint8_t* y, const uint8_t* vu, uint8x16x3_t* rgb)
+{
+    const uint8x16_t luma = vld1q_u8(y);
+    const uint8x8x2_t chroma = vld2_u8(vu);
+    // Every chroma sample covers two pixels
+    const uint8x8x2_t v = vzip_u8(chroma.val[0], chroma.val[0]);
+    const uint8x8x2_t u = vzip_u8(chroma.val[1], chroma.val[1]);
+
+    uint8x8_t rLo, gLo, bLo, rHi, gHi, bHi;
+    yuv8ToRgb(vget_low_u8(luma), v.val[0], u.val[0], &rLo, &gLo, &bLo);
+    yuv8ToRgb(vget_high_u8(luma), v.val[1], u.val[1], &rHi, &gHi, &bHi);
+
+    rgb->val[0] = vcombine_u8(rLo, rHi);
+    rgb->val[1] = vcombine_u8(gLo, gHi);
+    rgb->val[2] = vcombine_u8(bLo, bHi);
+}
+
+static void nv21ToRgb24RowNeon(const uint8_t* y, const uint8_t* vu, uint8_t* rgb, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t out;
+        yuv16ToRgb(y + x, vu + x, &out);
+        vst3q_u8(rgb + x * 3, out);
+    }
+
+    scalar.nv21ToRgb24Row(y + x, vu + x, rgb + x * 3, width - x);
+}
+
+static void nv21ToBgr24RowNeon(const uint8_t* y, const uint8_t* vu, uint8_t* bgr, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t out;
+        yuv16ToRgb(y + x, vu + x, &out);
+        const uint8x16_t red = out.val[0];
+        out.val[0] = out.val[2];
+        out.val[2] = red;
+        vst3q_u8(bgr + x * 3, out);
+    }
+
+    scalar.nv21ToBgr24Row(y + x, vu + x, bgr + x * 3, width - x);
+}
+
+static void nv21ToYuyvRowNeon(const uint8_t* y, const uint8_t* vu, uint8_t* yuyv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x2_t out;
+        out.val[0] = vld1q_u8(y + x);
+        out.val[1] = vrev16q_u8(vld1q_u8(vu + x));
+        vst2q_u8(yuyv + x * 2, out);
+    }
+
+    scalar.nv21ToYuyvRow(y + x, vu + x, yuyv + x * 2, width - x);
+}
+
+static void vuToUVRowNeon(const uint8_t* vu, uint8_t* uv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16)
+        vst1q_u8(uv + x, vrev16q_u8(vld1q_u8(vu + x)));
+
+    scalar.vuToUVRow(vu + x, uv + x, width - x);
+}
+
+static void vuToPlanarRowNeon(const uint8_t* vu, uint8_t* u, uint8_t* v, size_t width)
+{
+    size_t x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const uint8x16x2_t planes = vld2q_u8(vu + x);
+        vst1q_u8(u + x / 2, planes.val[1]);
+        vst1q_u8(v + x / 2, planes.val[0]);
+    }
+
+    scalar.vuToPlanarRow(vu + x, u + x / 2, v + x / 2, width - x);
+}
+
+const PixelConvertKernels pixelConvertNeonKernels = {
+    rgbaToRgb24RowNeon,
+    rgbaToBgr24RowNeon,
+    rgbaToYRowNeon,
+    rgbaToYuyvRowNeon,
+    rgbaToUVPlanarRowNeon,
+    rgbaToUVInterleavedRowNeon,
+    nv21ToRgb24RowNeon,
+    nv21ToBgr24RowNeon,
+    nv21ToYuyvRowNeon,
+    vuToUVRowNeon,
+    vuToPlanarRowNeon,
+};
+
+#endif // PIXELCONVERT_HAVE_NEON
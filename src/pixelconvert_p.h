@@ -0,0 +1,74 @@
+#ifndef PIXELCONVERT_P_H
+#define PIXELCONVERT_P_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Row kernels behind pixelConvert(). Every implementation has to produce
+// exactly the same bytes as the scalar reference in pixelconvert.cpp.
+//
+// Widths are in pixels and even for everything touching chroma. The
+// RGBA to UV kernels average a 2x2 block from two rows, NV21 input rows
+// share their VU row with the neighbouring row.
+struct PixelConvertKernels {
+    void (*rgbaToRgb24Row)(const uint8_t* rgba, uint8_t* rgb, size_t width);
+    void (*rgbaToBgr24Row)(const uint8_t* rgba, uint8_t* bgr, size_t width);
+    void (*rgbaToYRow)(const uint8_t* rgba, uint8_t* y, size_t width);
+    void (*rgbaToYuyvRow)(const uint8_t* rgba, uint8_t* yuyv, size_t width);
+    void (*rgbaToUVPlanarRow)(const uint8_t* rgba0, const uint8_t* rgba1,
+                              uint8_t* u, uint8_t* v, size_t width);
+    void (*rgbaToUVInterleavedRow)(const uint8_t* rgba0, const uint8_t* rgba1,
+                                   uint8_t* uv, size_t width);
+    void (*nv21ToRgb24Row)(const uint8_t* y, const uint8_t* vu, uint8_t* rgb, size_t width);
+    void (*nv21ToBgr24Row)(const uint8_t* y, const uint8_t* vu, uint8_t* bgr, size_t width);
+    void (*nv21ToYuyvRow)(const uint8_t* y, const uint8_t* vu, uint8_t* yuyv, size_t width);
+    void (*vuToUVRow)(const uint8_t* vu, uint8_t* uv, size_t width);
+    void (*vuToPlanarRow)(const uint8_t* vu, uint8_t* u, uint8_t* v, size_t width);
+};
+
+// BT.601 limited range, 8 bit fixed point
+static inline uint8_t pixelConvertY(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline uint8_t pixelConvertU(int r, int g, int b)
+{
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t pixelConvertV(int r, int g, int b)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t pixelConvertClamp(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// Y, U and V to one RGB pixel
+static inline void pixelConvertYuvToRgb(int y, int u, int v, uint8_t* r, uint8_t* g, uint8_t* b)
+{
+    const int c = y - 16;
+    const int d = u - 128;
+    const int e = v - 128;
+    *r = pixelConvertClamp((298 * c + 409 * e + 128) >> 8);
+    *g = pixelConvertClamp((298 * c - 100 * d - 208 * e + 128) >> 8);
+    *b = pixelConvertClamp((298 * c + 516 * d + 128) >> 8);
+}
+
+extern const PixelConvertKernels pixelConvertScalarKernels;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXELCONVERT_HAVE_X86 1
+extern const PixelConvertKernels pixelConvertSsse3Kernels;
+extern const PixelConvertKernels pixelConvertAvx2Kernels;
+#endif
+
+#if defined(__aarch64__) || defined(__arm__)
+#define PIXELCONVERT_HAVE_NEON 1
+extern const PixelConvertKernels pixelConvertNeonKernels;
+#endif
+
+#endif // PIXELCONVERT_P_H
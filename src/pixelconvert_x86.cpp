@@ -0,0 +1,476 @@
+#include "pixelconvert_p.h"
+
+#ifdef PIXELCONVERT_HAVE_X86
+
+#include <immintrin.h>
+
+// SSSE3 and AVX2 kernels. Built without global -m flags and only
+// selected after the CPU was checked, so every function that touches
+// the intrinsics carries its own target attribute.
+//
+// Channel dot products widen to 16 bit and use pmaddwd + phaddd, which
+// yields the same 32 bit intermediates as the scalar formulas. Leftover
+// pixels at the end of a row go through the scalar kernels.
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+static const PixelConvertKernels& scalar = pixelConvertScalarKernels;
+
+// ---- SSSE3 ----
+
+SSSE3 static inline __m128i coefficients(short r, short g, short b)
+{
+    return _mm_setr_epi16(r, g, b, 0, r, g, b, 0);
+}
+
+// 4 RGBA pixels to 4 dot products with the channel coefficients
+SSSE3 static inline __m128i dot4(__m128i pixels, __m128i coeffs)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coeffs);
+    const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coeffs);
+    return _mm_hadd_epi32(lo, hi);
+}
+
+// Same for 4 pixels already widened to 16 bit, two per register
+SSSE3 static inline __m128i dot4Wide(__m128i lo, __m128i hi, __m128i coeffs)
+{
+    return _mm_hadd_epi32(_mm_madd_epi16(lo, coeffs), _mm_madd_epi16(hi, coeffs));
+}
+
+// (sum + 128) >> 8 plus offset
+SSSE3 static inline __m128i descale(__m128i sum, int offset)
+{
+    const __m128i shifted = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+    return _mm_add_epi32(shifted, _mm_set1_epi32(offset));
+}
+
+SSSE3 static inline __m128i luma4(__m128i pixels)
+{
+    return descale(dot4(pixels, coefficients(66, 129, 25)), 16);
+}
+
+// Packs four RGBX pixels to 12 bytes at the bottom of the register
+SSSE3 static inline __m128i packRgb(__m128i pixels, bool swap)
+{
+    const __m128i rgb = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i bgr = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    return _mm_shuffle_epi8(pixels, swap ? bgr : rgb);
+}
+
+SSSE3 static inline void rgbaToPacked24(const uint8_t* rgba, uint8_t* out, size_t width, bool swap)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i a = packRgb(_mm_loadu_si128((const __m128i*)(rgba + x * 4)), swap);
+        const __m128i b = packRgb(_mm_loadu_si128((const __m128i*)(rgba + x * 4 + 16)), swap);
+        const __m128i c = packRgb(_mm_loadu_si128((const __m128i*)(rgba + x * 4 + 32)), swap);
+        const __m128i d = packRgb(_mm_loadu_si128((const __m128i*)(rgba + x * 4 + 48)), swap);
+
+        uint8_t* dst = out + x * 3;
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+
+    if (swap)
+        scalar.rgbaToBgr24Row(rgba + x * 4, out + x * 3, width - x);
+    else
+        scalar.rgbaToRgb24Row(rgba + x * 4, out + x * 3, width - x);
+}
+
+SSSE3 static void rgbaToRgb24RowSsse3(const uint8_t* rgba, uint8_t* rgb, size_t width)
+{
+    rgbaToPacked24(rgba, rgb, width, false);
+}
+
+SSSE3 static void rgbaToBgr24RowSsse3(const uint8_t* rgba, uint8_t* bgr, size_t width)
+{
+    rgbaToPacked24(rgba, bgr, width, true);
+}
+
+SSSE3 static void rgbaToYRowSsse3(const uint8_t* rgba, uint8_t* y, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i y0 = luma4(_mm_loadu_si128((const __m128i*)(rgba + x * 4)));
+        const __m128i y1 = luma4(_mm_loadu_si128((const __m128i*)(rgba + x * 4 + 16)));
+        const __m128i y2 = luma4(_mm_loadu_si128((const __m128i*)(rgba + x * 4 + 32)));
+        const __m128i y3 = luma4(_mm_loadu_si128((const __m128i*)(rgba + x * 4 + 48)));
+
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+        _mm_storeu_si128((__m128i*)(y + x), packed);
+    }
+
+    scalar.rgbaToYRow(rgba + x * 4, y + x, width - x);
+}
+
+// U and V of 4 chroma samples from 4 averaged pixels widened to 16 bit
+SSSE3 static inline void chroma4(__m128i lo, __m128i hi, __m128i* u, __m128i* v)
+{
+    *u = descale(dot4Wide(lo, hi, coefficients(-38, -74, 112)), 128);
+    *v = descale(dot4Wide(lo, hi, coefficients(112, -94, -18)), 128);
+}
+
+SSSE3 static inline __m128i evenPixels(__m128i a, __m128i b)
+{
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+SSSE3 static inline __m128i oddPixels(__m128i a, __m128i b)
+{
+    return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+SSSE3 static void rgbaToYuyvRowSsse3(const uint8_t* rgba, uint8_t* yuyv, size_t width)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(rgba + x * 4));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(rgba + x * 4 + 16));
+
+        const __m128i luma = _mm_packs_epi32(luma4(a), luma4(b));
+
+        // pavgb is exactly (a + b + 1) >> 1
+        const __m128i average = _mm_avg_epu8(evenPixels(a, b), oddPixels(a, b));
+        __m128i u, v;
+        chroma4(_mm_unpacklo_epi8(average, zero), _mm_unpackhi_epi8(average, zero), &u, &v);
+        const __m128i uv = _mm_packs_epi32(u, v);
+        const __m128i interleaved = _mm_unpacklo_epi16(uv, _mm_srli_si128(uv, 8));
+
+        const __m128i out = _mm_unpacklo_epi8(_mm_packus_epi16(luma, luma),
+                                              _mm_packus_epi16(interleaved, interleaved));
+        _mm_storeu_si128((__m128i*)(yuyv + x * 2), out);
+    }
+
+    scalar.rgbaToYuyvRow(rgba + x * 4, yuyv + x * 2, width - x);
+}
+
+// U and V of the 2x2 blocks covering 8 pixels of two rows
+SSSE3 static inline void chromaBlock8(const uint8_t* rgba0, const uint8_t* rgba1, __m128i* u, __m128i* v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a0 = _mm_loadu_si128((const __m128i*)rgba0);
+    const __m128i b0 = _mm_loadu_si128((const __m128i*)(rgba0 + 16));
+    const __m128i a1 = _mm_loadu_si128((const __m128i*)rgba1);
+    const __m128i b1 = _mm_loadu_si128((const __m128i*)(rgba1 + 16));
+
+    const __m128i e0 = evenPixels(a0, b0);
+    const __m128i o0 = oddPixels(a0, b0);
+    const __m128i e1 = evenPixels(a1, b1);
+    const __m128i o1 = oddPixels(a1, b1);
+
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(e0, zero), _mm_unpacklo_epi8(o0, zero));
+    lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_unpacklo_epi8(e1, zero), _mm_unpacklo_epi8(o1, zero)));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(e0, zero), _mm_unpackhi_epi8(o0, zero));
+    hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_unpackhi_epi8(e1, zero), _mm_unpackhi_epi8(o1, zero)));
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+    chroma4(lo, hi, u, v);
+}
+
+SSSE3 static void rgbaToUVPlanarRowSsse3(const uint8_t* rgba0, const uint8_t* rgba1,
+                                         uint8_t* u, uint8_t* v, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i u0, v0, u1, v1;
+        chromaBlock8(rgba0 + x * 4, rgba1 + x * 4, &u0, &v0);
+        chromaBlock8(rgba0 + x * 4 + 32, rgba1 + x * 4 + 32, &u1, &v1);
+
+        const __m128i us = _mm_packs_epi32(u0, u1);
+        const __m128i vs = _mm_packs_epi32(v0, v1);
+        _mm_storel_epi64((__m128i*)(u + x / 2), _mm_packus_epi16(us, us));
+        _mm_storel_epi64((__m128i*)(v + x / 2), _mm_packus_epi16(vs, vs));
+    }
+
+    scalar.rgbaToUVPlanarRow(rgba0 + x * 4, rgba1 + x * 4, u + x / 2, v + x / 2, width - x);
+}
+
+SSSE3 static void rgbaToUVInterleavedRowSsse3(const uint8_t* rgba0, const uint8_t* rgba1,
+                                              uint8_t* uv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i u0, v0, u1, v1;
+        chromaBlock8(rgba0 + x * 4, rgba1 + x * 4, &u0, &v0);
+        chromaBlock8(rgba0 + x * 4 + 32, rgba1 + x * 4 + 32, &u1, &v1);
+
+        const __m128i us = _mm_packs_epi32(u0, u1);
+        const __m128i vs = _mm_packs_epi32(v0, v1);
+        const __m128i out = _mm_packus_epi16(_mm_unpacklo_epi16(us, vs), _mm_unpackhi_epi16(us, vs));
+        _mm_storeu_si128((__m128i*)(uv + x), out);
+    }
+
+    scalar.rgbaToUVInterleavedRow(rgba0 + x * 4, rgba1 + x * 4, uv + x, width - x);
+}
+
+// (sum + 128) >> 8 for 8 values in two halves, saturated to bytes
+SSSE3 static inline __m128i descaleClamp(__m128i lo, __m128i hi)
+{
+    const __m128i round = _mm_set1_epi32(128);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 8);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 8);
+    const __m128i words = _mm_packs_epi32(lo, hi);
+    return _mm_packus_epi16(words, words);
+}
+
+// 8 NV21 pixels to 8 bytes each of R, G and B
+SSSE3 static inline void yuv8ToRgb(const uint8_t* y, const uint8_t* vu, __m128i* r, __m128i* g, __m128i* b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i chroma = _mm_loadl_epi64((const __m128i*)vu);
+    const __m128i bias = _mm_set1_epi16(128);
+
+    const __m128i c = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)y), zero), _mm_set1_epi16(16));
+    const __m128i e = _mm_sub_epi16(_mm_shuffle_epi8(chroma, _mm_setr_epi8(0, -1, 0, -1, 2, -1, 2, -1, 4, -1, 4, -1, 6, -1, 6, -1)), bias);
+    const __m128i d = _mm_sub_epi16(_mm_shuffle_epi8(chroma, _mm_setr_epi8(1, -1, 1, -1, 3, -1, 3, -1, 5, -1, 5, -1, 7, -1, 7, -1)), bias);
+
+    const __m128i ceLo = _mm_unpacklo_epi16(c, e);
+    const __m128i ceHi = _mm_unpackhi_epi16(c, e);
+    const __m128i cdLo = _mm_unpacklo_epi16(c, d);
+    const __m128i cdHi = _mm_unpackhi_epi16(c, d);
+    // G's third term and the rounding constant go through (e, 1)
+    const __m128i eOneLo = _mm_unpacklo_epi16(e, _mm_set1_epi16(1));
+    const __m128i eOneHi = _mm_unpackhi_epi16(e, _mm_set1_epi16(1));
+
+    const __m128i kR = _mm_setr_epi16(298, 409, 298, 409, 298, 409, 298, 409);
+    const __m128i kB = _mm_setr_epi16(298, 516, 298, 516, 298, 516, 298, 516);
+    const __m128i kG = _mm_setr_epi16(298, -100, 298, -100, 298, -100, 298, -100);
+    const __m128i kGe = _mm_setr_epi16(-208, 128, -208, 128, -208, 128, -208, 128);
+    const __m128i none = _mm_setzero_si128();
+
+    *r = descaleClamp(_mm_madd_epi16(ceLo, kR), _mm_madd_epi16(ceHi, kR));
+    *b = descaleClamp(_mm_madd_epi16(cdLo, kB), _mm_madd_epi16(cdHi, kB));
+    // The rounding constant is already in the (e, 1) product
+    const __m128i gLo = _mm_add_epi32(_mm_madd_epi16(cdLo, kG), _mm_madd_epi16(eOneLo, kGe));
+    const __m128i gHi = _mm_add_epi32(_mm_madd_epi16(cdHi, kG), _mm_madd_epi16(eOneHi, kGe));
+    const __m128i gWords = _mm_packs_epi32(_mm_srai_epi32(gLo, 8), _mm_srai_epi32(gHi, 8));
+    *g = _mm_packus_epi16(gWords, none);
+}
+
+// Interleaves 8 bytes of each channel to 24 bytes
+SSSE3 static inline void storePacked24(uint8_t* out, __m128i first, __m128i second, __m128i third)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pairs = _mm_unpacklo_epi8(first, second);
+    const __m128i thirds = _mm_unpacklo_epi8(third, zero);
+    const __m128i a = packRgb(_mm_unpacklo_epi16(pairs, thirds), false);
+    const __m128i b = packRgb(_mm_unpackhi_epi16(pairs, thirds), false);
+
+    _mm_storeu_si128((__m128i*)out, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+    _mm_storel_epi64((__m128i*)(out + 16), _mm_srli_si128(b, 4));
+}
+
+SSSE3 static void nv21ToRgb24RowSsse3(const uint8_t* y, const uint8_t* vu, uint8_t* rgb, size_t width)
+{
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i r, g, b;
+        yuv8ToRgb(y + x, vu + x, &r, &g, &b);
+        storePacked24(rgb + x * 3, r, g, b);
+    }
+
+    scalar.nv21ToRgb24Row(y + x, vu + x, rgb + x * 3, width - x);
+}
+
+SSSE3 static void nv21ToBgr24RowSsse3(const uint8_t* y, const uint8_t* vu, uint8_t* bgr, size_t width)
+{
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i r, g, b;
+        yuv8ToRgb(y + x, vu + x, &r, &g, &b);
+        storePacked24(bgr + x * 3, b, g, r);
+    }
+
+    scalar.nv21ToBgr24Row(y + x, vu + x, bgr + x * 3, width - x);
+}
+
+SSSE3 static inline __m128i swapPairs(__m128i vu)
+{
+    return _mm_shuffle_epi8(vu, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+}
+
+SSSE3 static void nv21ToYuyvRowSsse3(const uint8_t* y, const uint8_t* vu, uint8_t* yuyv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i luma = _mm_loadu_si128((const __m128i*)(y + x));
+        const __m128i uv = swapPairs(_mm_loadu_si128((const __m128i*)(vu + x)));
+        _mm_storeu_si128((__m128i*)(yuyv + x * 2), _mm_unpacklo_epi8(luma, uv));
+        _mm_storeu_si128((__m128i*)(yuyv + x * 2 + 16), _mm_unpackhi_epi8(luma, uv));
+    }
+
+    scalar.nv21ToYuyvRow(y + x, vu + x, yuyv + x * 2, width - x);
+}
+
+SSSE3 static void vuToUVRowSsse3(const uint8_t* vu, uint8_t* uv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16)
+        _mm_storeu_si128((__m128i*)(uv + x), swapPairs(_mm_loadu_si128((const __m128i*)(vu + x))));
+
+    scalar.vuToUVRow(vu + x, uv + x, width - x);
+}
+
+SSSE3 static void vuToPlanarRowSsse3(const uint8_t* vu, uint8_t* u, uint8_t* v, size_t width)
+{
+    const __m128i split = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, 0, 2, 4, 6, 8, 10, 12, 14);
+
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i planes = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(vu + x)), split);
+        _mm_storel_epi64((__m128i*)(u + x / 2), planes);
+        _mm_storel_epi64((__m128i*)(v + x / 2), _mm_srli_si128(planes, 8));
+    }
+
+    scalar.vuToPlanarRow(vu + x, u + x / 2, v + x / 2, width - x);
+}
+
+const PixelConvertKernels pixelConvertSsse3Kernels = {
+    rgbaToRgb24RowSsse3,
+    rgbaToBgr24RowSsse3,
+    rgbaToYRowSsse3,
+    rgbaToYuyvRowSsse3,
+    rgbaToUVPlanarRowSsse3,
+    rgbaToUVInterleavedRowSsse3,
+    nv21ToRgb24RowSsse3,
+    nv21ToBgr24RowSsse3,
+    nv21ToYuyvRowSsse3,
+    vuToUVRowSsse3,
+    vuToPlanarRowSsse3,
+};
+
+// ---- AVX2 ----
+// Only the RGBA to YUV kernels, which dominate the CPU path. Everything
+// else is memory bound and stays on SSSE3.
+
+AVX2 static inline __m256i coefficients256(short r, short g, short b)
+{
+    return _mm256_setr_epi16(r, g, b, 0, r, g, b, 0, r, g, b, 0, r, g, b, 0);
+}
+
+AVX2 static inline __m256i descale256(__m256i sum, int offset)
+{
+    const __m256i shifted = _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+    return _mm256_add_epi32(shifted, _mm256_set1_epi32(offset));
+}
+
+// 8 RGBA pixels to 8 luma values, in order since phaddd works per lane
+AVX2 static inline __m256i luma8(__m256i pixels)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i coeffs = coefficients256(66, 129, 25);
+    const __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), coeffs);
+    const __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), coeffs);
+    return descale256(_mm256_hadd_epi32(lo, hi), 16);
+}
+
+AVX2 static void rgbaToYRowAvx2(const uint8_t* rgba, uint8_t* y, size_t width)
+{
+    // Per lane packing leaves the 4 pixel groups in 0 2 4 6 1 3 5 7 order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i y0 = luma8(_mm256_loadu_si256((const __m256i*)(rgba + x * 4)));
+        const __m256i y1 = luma8(_mm256_loadu_si256((const __m256i*)(rgba + x * 4 + 32)));
+        const __m256i y2 = luma8(_mm256_loadu_si256((const __m256i*)(rgba + x * 4 + 64)));
+        const __m256i y3 = luma8(_mm256_loadu_si256((const __m256i*)(rgba + x * 4 + 96)));
+
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(y0, y1), _mm256_packs_epi32(y2, y3));
+        _mm256_storeu_si256((__m256i*)(y + x), _mm256_permutevar8x32_epi32(packed, order));
+    }
+
+    rgbaToYRowSsse3(rgba + x * 4, y + x, width - x);
+}
+
+// U and V of the 2x2 blocks covering 16 pixels of two rows, as 8 ordered
+// 32 bit values each
+AVX2 static inline void chromaBlock16(const uint8_t* rgba0, const uint8_t* rgba1, __m256i* u, __m256i* v)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i a0 = _mm256_loadu_si256((const __m256i*)rgba0);
+    const __m256i b0 = _mm256_loadu_si256((const __m256i*)(rgba0 + 32));
+    const __m256i a1 = _mm256_loadu_si256((const __m256i*)rgba1);
+    const __m256i b1 = _mm256_loadu_si256((const __m256i*)(rgba1 + 32));
+
+#define EVEN(a, b) _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)))
+#define ODD(a, b) _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(3, 1, 3, 1)))
+    const __m256i e0 = EVEN(a0, b0);
+    const __m256i o0 = ODD(a0, b0);
+    const __m256i e1 = EVEN(a1, b1);
+    const __m256i o1 = ODD(a1, b1);
+#undef EVEN
+#undef ODD
+
+    const __m256i two = _mm256_set1_epi16(2);
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(e0, zero), _mm256_unpacklo_epi8(o0, zero));
+    lo = _mm256_add_epi16(lo, _mm256_add_epi16(_mm256_unpacklo_epi8(e1, zero), _mm256_unpacklo_epi8(o1, zero)));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(e0, zero), _mm256_unpackhi_epi8(o0, zero));
+    hi = _mm256_add_epi16(hi, _mm256_add_epi16(_mm256_unpackhi_epi8(e1, zero), _mm256_unpackhi_epi8(o1, zero)));
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+
+    // Blocks come out as 0 1 4 5 2 3 6 7
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    const __m256i kU = coefficients256(-38, -74, 112);
+    const __m256i kV = coefficients256(112, -94, -18);
+    *u = _mm256_permutevar8x32_epi32(descale256(_mm256_hadd_epi32(_mm256_madd_epi16(lo, kU), _mm256_madd_epi16(hi, kU)), 128), order);
+    *v = _mm256_permutevar8x32_epi32(descale256(_mm256_hadd_epi32(_mm256_madd_epi16(lo, kV), _mm256_madd_epi16(hi, kV)), 128), order);
+}
+
+AVX2 static void rgbaToUVPlanarRowAvx2(const uint8_t* rgba0, const uint8_t* rgba1,
+                                       uint8_t* u, uint8_t* v, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i u8, v8;
+        chromaBlock16(rgba0 + x * 4, rgba1 + x * 4, &u8, &v8);
+
+        const __m128i us = _mm_packs_epi32(_mm256_castsi256_si128(u8), _mm256_extracti128_si256(u8, 1));
+        const __m128i vs = _mm_packs_epi32(_mm256_castsi256_si128(v8), _mm256_extracti128_si256(v8, 1));
+        _mm_storel_epi64((__m128i*)(u + x / 2), _mm_packus_epi16(us, us));
+        _mm_storel_epi64((__m128i*)(v + x / 2), _mm_packus_epi16(vs, vs));
+    }
+
+    scalar.rgbaToUVPlanarRow(rgba0 + x * 4, rgba1 + x * 4, u + x / 2, v + x / 2, width - x);
+}
+
+AVX2 static void rgbaToUVInterleavedRowAvx2(const uint8_t* rgba0, const uint8_t* rgba1,
+                                            uint8_t* uv, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i u8, v8;
+        chromaBlock16(rgba0 + x * 4, rgba1 + x * 4, &u8, &v8);
+
+        const __m128i us = _mm_packs_epi32(_mm256_castsi256_si128(u8), _mm256_extracti128_si256(u8, 1));
+        const __m128i vs = _mm_packs_epi32(_mm256_castsi256_si128(v8), _mm256_extracti128_si256(v8, 1));
+        const __m128i out = _mm_packus_epi16(_mm_unpacklo_epi16(us, vs), _mm_unpackhi_epi16(us, vs));
+        _mm_storeu_si128((__m128i*)(uv + x), out);
+    }
+
+    scalar.rgbaToUVInterleavedRow(rgba0 + x * 4, rgba1 + x * 4, uv + x, width - x);
+}
+
+const PixelConvertKernels pixelConvertAvx2Kernels = {
+    rgbaToRgb24RowSsse3,
+    rgbaToBgr24RowSsse3,
+    rgbaToYRowAvx2,
+    rgbaToYuyvRowSsse3,
+    rgbaToUVPlanarRowAvx2,
+    rgbaToUVInterleavedRowAvx2,
+    nv21ToRgb24RowSsse3,
+    nv21ToBgr24RowSsse3,
+    nv21ToYuyvRowSsse3,
+    vuToUVRowSsse3,
+    vuToPlanarRowSsse3,
+};
+
+#endif // PIXELCONVERT_HAVE_X86
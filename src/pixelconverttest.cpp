@@ -0,0 +1,100 @@
+#include <QDebug>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "pixelconvert.h"
+#include "videoformat.h"
+
+// Runs every conversion with every instruction set the CPU has and
+// compares the output byte for byte with the scalar reference. Output
+// buffers carry a guard area so writes past the frame show up too.
+// Exits non-zero on the first mismatch.
+
+// Odd and even widths around the 16 and 32 pixel vector blocks plus a
+// few that leave every kind of tail
+static const size_t WIDTHS[] = { 1, 2, 3, 6, 7, 14, 15, 16, 17, 18, 30, 31, 32, 33, 34,
+                                 46, 62, 64, 66, 98, 126, 130, 638, 640 };
+static const size_t HEIGHTS[] = { 1, 2, 3, 4, 6 };
+static const size_t GUARD_SIZE = 64;
+static const uint8_t GUARD_BYTE = 0xa5;
+
+static bool convertWith(PixelConvertIsa isa, const std::vector<uint8_t>& source, PixelFormat from,
+                        std::vector<uint8_t>* destination, PixelFormat to, size_t width, size_t height)
+{
+    pixelConvertSetIsa(isa);
+    std::fill(destination->begin(), destination->end(), GUARD_BYTE);
+    return pixelConvert(source.data(), from, destination->data(), to, width, height);
+}
+
+static bool checkCase(PixelConvertIsa isa, PixelFormat from, PixelFormat to,
+                      size_t width, size_t height, std::mt19937* random)
+{
+    // Large enough for any format at this size, whatever the subsampling
+    std::vector<uint8_t> source(width * height * 4);
+    for (uint8_t& byte : source)
+        byte = (*random)() & 0xff;
+
+    std::vector<uint8_t> expected(width * height * 4 + GUARD_SIZE);
+    std::vector<uint8_t> actual(expected.size());
+    const bool expectedResult = convertWith(PixelConvertIsa::Scalar, source, from, &expected, to, width, height);
+    const bool actualResult = convertWith(isa, source, from, &actual, to, width, height);
+
+    if (expectedResult != actualResult) {
+        qWarning() << pixelConvertIsaName(isa) << pixelFormatName(from) << "to" << pixelFormatName(to)
+                   << width << height << "returned" << actualResult << "instead of" << expectedResult;
+        return false;
+    }
+
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (expected[i] != actual[i]) {
+            qWarning() << pixelConvertIsaName(isa) << pixelFormatName(from) << "to" << pixelFormatName(to)
+                       << width << height << "differs at byte" << i << "of" << expected.size()
+                       << ":" << actual[i] << "instead of" << expected[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    Q_UNUSED(argc);
+    Q_UNUSED(argv);
+
+    static const PixelFormat sources[] = { PixelFormat::Rgba32, PixelFormat::Nv21 };
+    static const PixelFormat targets[] = { PixelFormat::Rgb24, PixelFormat::Bgr24, PixelFormat::Yuyv,
+                                           PixelFormat::Nv12, PixelFormat::I420 };
+
+    QVector<PixelConvertIsa> isas;
+    for (PixelConvertIsa isa : { PixelConvertIsa::Scalar, PixelConvertIsa::Ssse3,
+                                 PixelConvertIsa::Avx2, PixelConvertIsa::Neon }) {
+        if (pixelConvertIsaAvailable(isa))
+            isas.append(isa);
+    }
+
+    // Same data on every run so failures reproduce
+    std::mt19937 random(20241017);
+    int cases = 0;
+
+    for (PixelConvertIsa isa : isas) {
+        for (PixelFormat from : sources) {
+            for (PixelFormat to : targets) {
+                for (size_t width : WIDTHS) {
+                    for (size_t height : HEIGHTS) {
+                        if (!checkCase(isa, from, to, width, height, &random))
+                            return 1;
+                        ++cases;
+                    }
+                }
+            }
+        }
+        qInfo() << pixelConvertIsaName(isa) << "matches the scalar reference";
+    }
+
+    qInfo() << cases << "cases passed";
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include "sharedmemorysink.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "accessmediator.h"
+#include "pipelinestats.h"
+
+// Clients connecting at the same time wait in the kernel meanwhile
+static const int LISTEN_BACKLOG = 8;
+
+// Slot data starts page aligned and every slot on a cache line
+static const size_t DATA_ALIGNMENT = 4096;
+static const size_t SLOT_ALIGNMENT = 64;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+SharedMemorySink::SharedMemorySink(QObject *parent) : QObject(parent)
+{
+}
+
+SharedMemorySink::~SharedMemorySink()
+{
+    for (const Client& client : this->m_clients) {
+        delete client.notifier;
+        close(client.fd);
+        close(client.eventFd);
+    }
+    this->m_clients.clear();
+
+    delete this->m_listenNotifier;
+    if (this->m_listenFd >= 0) {
+        close(this->m_listenFd);
+        unlink(this->m_path.toUtf8().constData());
+    }
+
+    destroyRing();
+}
+
+void SharedMemorySink::setSupportedFormats(const QVector<VideoFormat>& formats)
+{
+    this->m_formats = formats;
+}
+
+void SharedMemorySink::setFormat(const VideoFormat& format)
+{
+    QMutexLocker locker(&this->m_mutex);
+    this->m_format = format;
+}
+
+bool SharedMemorySink::listen(const QString& path)
+{
+    if (!createRing())
+        return false;
+
+    const QByteArray name = path.toUtf8();
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if ((size_t)name.size() >= sizeof(address.sun_path)) {
+        qWarning("Shared memory socket path too long: %s", name.constData());
+        return false;
+    }
+    strcpy(address.sun_path, name.constData());
+
+    this->m_listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (this->m_listenFd < 0) {
+        qWarning("Failed to create shared memory socket: %s", strerror(errno));
+        return false;
+    }
+
+    // A previous run may have left its socket behind
+    unlink(name.constData());
+    if (bind(this->m_listenFd, (struct sockaddr*)&address, sizeof(address)) < 0
+            || ::listen(this->m_listenFd, LISTEN_BACKLOG) < 0) {
+        qWarning("Failed to listen on %s: %s", name.constData(), strerror(errno));
+        close(this->m_listenFd);
+        this->m_listenFd = -1;
+        return false;
+    }
+    this->m_path = path;
+
+    this->m_listenNotifier = new QSocketNotifier(this->m_listenFd, QSocketNotifier::Read, this);
+    QObject::connect(this->m_listenNotifier, &QSocketNotifier::activated,
+                     this, &SharedMemorySink::acceptClient);
+
+    qInfo("Offering %u slots of %u bytes on %s", SLOT_COUNT, this->m_slotSize, name.constData());
+    return true;
+}
+
+QString SharedMemorySink::path()
+{
+    return this->m_path;
+}
+
+int SharedMemorySink::clientCount()
+{
+    QMutexLocker locker(&this->m_mutex);
+    return this->m_clients.size();
+}
+
+bool SharedMemorySink::createRing()
+{
+    size_t frameSize = this->m_format.frameSize();
+    for (const VideoFormat& format : this->m_formats) {
+        if (format.frameSize() > frameSize)
+            frameSize = format.frameSize();
+    }
+    if (frameSize == 0) {
+        qWarning("No format to size the shared memory ring for");
+        return false;
+    }
+
+    const size_t headerSize = sizeof(struct shm_ring_header) + SLOT_COUNT * sizeof(struct shm_ring_slot);
+    const size_t dataOffset = alignUp(headerSize, DATA_ALIGNMENT);
+    this->m_slotSize = alignUp(frameSize, SLOT_ALIGNMENT);
+    this->m_ringSize = dataOffset + SLOT_COUNT * (size_t)this->m_slotSize;
+
+    this->m_ringFd = memfd_create("opticd-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (this->m_ringFd < 0) {
+        qWarning("Failed to create shared memory ring: %s", strerror(errno));
+        return false;
+    }
+
+    // Sealed at its size, so a client can map all of it without fearing
+    // SIGBUS from a truncation
+    if (ftruncate(this->m_ringFd, this->m_ringSize) < 0
+            || fcntl(this->m_ringFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        qWarning("Failed to size shared memory ring: %s", strerror(errno));
+        destroyRing();
+        return false;
+    }
+
+    void* ring = mmap(nullptr, this->m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, this->m_ringFd, 0);
+    if (ring == MAP_FAILED) {
+        qWarning("Failed to map shared memory ring: %s", strerror(errno));
+        destroyRing();
+        return false;
+    }
+    this->m_ring = (uint8_t*)ring;
+
+    // Reopening through /proc drops write access, clients can't map the
+    // ring writable with that descriptor
+    const QString self = QStringLiteral("/proc/self/fd/%1").arg(this->m_ringFd);
+    this->m_readOnlyFd = open(self.toUtf8().constData(), O_RDONLY | O_CLOEXEC);
+    if (this->m_readOnlyFd < 0) {
+        qWarning("Failed to reopen shared memory ring read-only: %s", strerror(errno));
+        destroyRing();
+        return false;
+    }
+
+    // Fresh memfd pages are zeroed, which leaves every slot unlocked
+    struct shm_ring_header* header = (struct shm_ring_header*)this->m_ring;
+    header->magic = SHM_RING_MAGIC;
+    header->version = SHM_RING_VERSION;
+    header->slot_count = SLOT_COUNT;
+    header->slot_size = this->m_slotSize;
+    header->data_offset = dataOffset;
+    header->latest = 0;
+    return true;
+}
+
+void SharedMemorySink::destroyRing()
+{
+    if (this->m_ring)
+        munmap(this->m_ring, this->m_ringSize);
+    this->m_ring = nullptr;
+    if (this->m_readOnlyFd >= 0)
+        close(this->m_readOnlyFd);
+    this->m_readOnlyFd = -1;
+    if (this->m_ringFd >= 0)
+        close(this->m_ringFd);
+    this->m_ringFd = -1;
+}
+
+struct shm_ring_slot* SharedMemorySink::slotAt(uint32_t index)
+{
+    return (struct shm_ring_slot*)(this->m_ring + sizeof(struct shm_ring_header)) + index;
+}
+
+bool SharedMemorySink::sendRing(int fd, int eventFd)
+{
+    struct shm_ring_hello hello;
+    hello.magic = SHM_RING_MAGIC;
+    hello.version = SHM_RING_VERSION;
+    hello.size = this->m_ringSize;
+
+    const int fds[2] = { this->m_readOnlyFd, eventFd };
+    union {
+        char buffer[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec iov;
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    return sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)sizeof(hello);
+}
+
+void SharedMemorySink::acceptClient()
+{
+    for (;;) {
+        const int fd = accept4(this->m_listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                qWarning("Failed to accept shared memory client: %s", strerror(errno));
+            if (errno != EINTR)
+                return;
+            continue;
+        }
+
+        struct ucred credentials;
+        socklen_t length = sizeof(credentials);
+        const QString consumer = getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0
+                ? AccessMediator::processName(credentials.pid)
+                : QString::number(fd);
+
+        const int eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (eventFd < 0 || !sendRing(fd, eventFd)) {
+            qWarning("Failed to hand the shared memory ring to %s: %s",
+                     consumer.toUtf8().data(), strerror(errno));
+            if (eventFd >= 0)
+                close(eventFd);
+            close(fd);
+            continue;
+        }
+
+        // Clients don't send anything, readability means they hung up
+        QSocketNotifier* notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        QObject::connect(notifier, &QSocketNotifier::activated, this, [this, fd]() {
+            readClient(fd);
+        });
+
+        {
+            QMutexLocker locker(&this->m_mutex);
+            this->m_clients.push_back({ fd, eventFd, notifier, consumer });
+        }
+
+        qInfo("Shared memory client %s connected to %s", consumer.toUtf8().data(),
+              this->m_path.toUtf8().constData());
+        emit clientConnected(consumer);
+    }
+}
+
+void SharedMemorySink::readClient(int fd)
+{
+    char buffer[64];
+    const ssize_t count = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (count > 0 || (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)))
+        return;
+
+    removeClient(fd);
+}
+
+void SharedMemorySink::removeClient(int fd)
+{
+    Client client;
+    {
+        QMutexLocker locker(&this->m_mutex);
+        auto it = this->m_clients.begin();
+        while (it != this->m_clients.end() && it->fd != fd)
+            ++it;
+        if (it == this->m_clients.end())
+            return;
+        client = *it;
+        this->m_clients.erase(it);
+    }
+
+    // Called from the notifier's own signal, so it goes later
+    client.notifier->setEnabled(false);
+    client.notifier->deleteLater();
+    close(client.fd);
+    close(client.eventFd);
+
+    qInfo("Shared memory client %s left %s", client.consumer.toUtf8().data(),
+          this->m_path.toUtf8().constData());
+    emit clientDisconnected(client.consumer);
+}
+
+void SharedMemorySink::pushCapture(FrameRef capture)
+{
+    if (capture.isNull())
+        return;
+
+    QMutexLocker locker(&this->m_mutex);
+    if (!this->m_ring || this->m_clients.empty())
+        return;
+
+    // Same checks as the loopback device, compressed frames vary in size
+    const VideoFormat& format = this->m_format;
+    if (capture.size() > this->m_slotSize
+            || (!pixelFormatIsCompressed(format.pixelFormat) && capture.size() != format.frameSize())) {
+        qWarning("Shared memory frame size mismatch: %zu bytes for %zu", capture.size(), format.frameSize());
+        return;
+    }
+
+    struct shm_ring_header* header = (struct shm_ring_header*)this->m_ring;
+    const uint64_t sequence = ++this->m_sequence;
+    const uint32_t index = sequence % SLOT_COUNT;
+    struct shm_ring_slot* slot = slotAt(index);
+    uint8_t* data = this->m_ring + header->data_offset + (size_t)index * this->m_slotSize;
+
+    // Odd while the slot is written, readers overlapping it retry or skip
+    const uint32_t lock = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->lock, lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(data, capture.data(), capture.size());
+    slot->fourcc = pixelFormatFourCC(format.pixelFormat);
+    slot->width = format.width;
+    slot->height = format.height;
+    slot->bytes_per_line = pixelFormatIsCompressed(format.pixelFormat)
+            ? 0 : pixelFormatBytesPerLine(format.pixelFormat, format.width);
+    slot->bytes_used = capture.size();
+    slot->sequence = sequence;
+    slot->timestamp_ns = capture.timestamp() ? capture.timestamp() : monotonicNanoseconds();
+    slot->capture_sequence = capture.sequence();
+
+    __atomic_store_n(&slot->lock, lock + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->latest, sequence, __ATOMIC_RELEASE);
+
+    // A full counter means the client stopped reading, it catches up
+    // with the latest frame whenever it gets to it
+    const uint64_t one = 1;
+    for (const Client& client : this->m_clients) {
+        if (write(client.eventFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            qDebug("Failed to notify shared memory client %s: %s",
+                   client.consumer.toUtf8().data(), strerror(errno));
+    }
+}
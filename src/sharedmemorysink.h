@@ -0,0 +1,84 @@
+#ifndef SHAREDMEMORYSINK_H
+#define SHAREDMEMORYSINK_H
+
+#include <QMutex>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+#include <QVector>
+
+#include <vector>
+
+#include "framepool.h"
+#include "shmring.h"
+#include "videoformat.h"
+
+// Offers frames to local clients through a memfd ring next to the
+// loopback device, see shmring.h for the layout and protocol. Frames are
+// copied into the ring once, clients map it and read them in place.
+class SharedMemorySink : public QObject
+{
+    Q_OBJECT
+public:
+    static const uint32_t SLOT_COUNT = 4;
+
+    explicit SharedMemorySink(QObject *parent = nullptr);
+    ~SharedMemorySink();
+
+    // Slots are sized for the largest format, call before listen()
+    void setSupportedFormats(const QVector<VideoFormat>& formats);
+    // Layout of the frames pushed from now on, from any thread
+    void setFormat(const VideoFormat& format);
+
+    // Creates the ring and the socket clients connect to
+    bool listen(const QString& path);
+    QString path();
+    int clientCount();
+
+public slots:
+    // From any thread, dropped while nobody is connected
+    void pushCapture(FrameRef capture);
+
+signals:
+    void clientConnected(const QString consumer);
+    void clientDisconnected(const QString consumer);
+
+private slots:
+    void acceptClient();
+
+private:
+    struct Client {
+        int fd;
+        int eventFd;
+        QSocketNotifier* notifier;
+        QString consumer;
+    };
+
+    bool createRing();
+    void destroyRing();
+    bool sendRing(int fd, int eventFd);
+    void readClient(int fd);
+    void removeClient(int fd);
+    struct shm_ring_slot* slotAt(uint32_t index);
+
+    QVector<VideoFormat> m_formats;
+    VideoFormat m_format;
+    QString m_path;
+
+    int m_listenFd = -1;
+    QSocketNotifier* m_listenNotifier = nullptr;
+
+    // Writable ring, clients get the read-only descriptor
+    int m_ringFd = -1;
+    int m_readOnlyFd = -1;
+    uint8_t* m_ring = nullptr;
+    size_t m_ringSize = 0;
+    uint32_t m_slotSize = 0;
+    uint64_t m_sequence = 0;
+
+    // Guards the format, the write position and the clients
+    QMutex m_mutex;
+    std::vector<Client> m_clients;
+};
+
+#endif // SHAREDMEMORYSINK_H
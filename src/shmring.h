@@ -0,0 +1,62 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+
+/*
+ * Shared memory frame ring offered by opticd to local clients, plain C
+ * so clients can include it as is.
+ *
+ * A client connects to the SOCK_SEQPACKET socket of a device and gets a
+ * struct shm_ring_hello with two descriptors attached: the read-only
+ * memfd holding the ring and an eventfd signalled after every frame.
+ * Closing the socket ends the session.
+ *
+ * The memfd starts with struct shm_ring_header followed by slot_count
+ * struct shm_ring_slot. Slot i's pixels are slot_size bytes at
+ * data_offset + i * slot_size.
+ *
+ * Frame n lands in slot n % slot_count under a sequence lock. The
+ * writer makes `lock` odd, fills the slot, makes `lock` even again and
+ * then stores n into `latest`. A reader loads `latest` and the slot's
+ * `lock` with acquire semantics, uses the frame, and loads `lock` again
+ * after an acquire fence. The frame was intact if `lock` was even and
+ * unchanged and `sequence` is n; otherwise it was overwritten meanwhile.
+ */
+
+#define SHM_RING_MAGIC 0x4354504fu /* "OPTC" */
+#define SHM_RING_VERSION 1u
+
+struct shm_ring_hello {
+    uint32_t magic;
+    uint32_t version;
+    /* Bytes to map */
+    uint64_t size;
+};
+
+struct shm_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint64_t data_offset;
+    /* Sequence of the newest complete frame, 0 before the first one */
+    uint64_t latest;
+};
+
+struct shm_ring_slot {
+    uint32_t lock;
+    /* V4L2 fourcc, frame layout as on the loopback device */
+    uint32_t fourcc;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes_per_line;
+    uint32_t bytes_used;
+    uint64_t sequence;
+    /* CLOCK_MONOTONIC capture time, or publishing time if unknown */
+    uint64_t timestamp_ns;
+    /* Source's frame counter, gaps are frames dropped before the ring */
+    uint64_t capture_sequence;
+};
+
+#endif /* SHMRING_H */
@@ -0,0 +1,58 @@
+#include "statsservice.h"
+
+#include <QDBusConnection>
+#include <QDebug>
+
+const QString StatsService::SERVICE = QStringLiteral("org.opticd");
+const QString StatsService::PATH = QStringLiteral("/org/opticd/Stats");
+
+StatsService::StatsService(QObject *parent) : QObject(parent)
+{
+}
+
+StatsService::~StatsService()
+{
+    QDBusConnection::sessionBus().unregisterObject(PATH);
+}
+
+bool StatsService::registerOnBus()
+{
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.registerService(SERVICE)) {
+        qWarning() << "Failed to register" << SERVICE << "on the session bus";
+        return false;
+    }
+    if (!bus.registerObject(PATH, this, QDBusConnection::ExportScriptableSlots)) {
+        qWarning() << "Failed to register" << PATH << "on the session bus";
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<PipelineStats> StatsService::addPipeline(const QString& name)
+{
+    QString unique = name;
+    for (int i = 2; Pipelines().contains(unique); i++)
+        unique = name + QStringLiteral(" %1").arg(i);
+
+    auto stats = std::make_shared<PipelineStats>(unique);
+    this->m_pipelines.push_back(stats);
+    return stats;
+}
+
+QStringList StatsService::Pipelines()
+{
+    QStringList names;
+    for (const std::shared_ptr<PipelineStats>& stats : this->m_pipelines)
+        names.append(stats->name());
+    return names;
+}
+
+QVariantMap StatsService::Stats(const QString& name)
+{
+    for (const std::shared_ptr<PipelineStats>& stats : this->m_pipelines) {
+        if (stats->name() == name)
+            return stats->snapshot();
+    }
+    return QVariantMap();
+}
@@ -0,0 +1,41 @@
+#ifndef STATSSERVICE_H
+#define STATSSERVICE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <memory>
+#include <vector>
+
+#include "pipelinestats.h"
+
+// Publishes every camera's PipelineStats on the session bus as
+// org.opticd /org/opticd/Stats, latencies in microseconds
+class StatsService : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.opticd.Stats")
+
+public:
+    static const QString SERVICE;
+    static const QString PATH;
+
+    explicit StatsService(QObject *parent = nullptr);
+    ~StatsService();
+
+    // Registers the service and object, false if the bus refused
+    bool registerOnBus();
+
+    // Names are made unique by appending a number
+    std::shared_ptr<PipelineStats> addPipeline(const QString& name);
+
+public slots:
+    Q_SCRIPTABLE QStringList Pipelines();
+    Q_SCRIPTABLE QVariantMap Stats(const QString& name);
+
+private:
+    std::vector<std::shared_ptr<PipelineStats>> m_pipelines;
+};
+
+#endif // STATSSERVICE_H
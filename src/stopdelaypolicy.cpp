@@ -0,0 +1,82 @@
+#include "stopdelaypolicy.h"
+
+#include <QMutexLocker>
+
+#include "pipelinestats.h"
+
+// Weight of the newest observation in the moving averages
+static const double LEARNING_RATE = 0.3;
+// Reopens that happen at least this often get waited for
+static const double REOPEN_THRESHOLD = 0.5;
+// Headroom on top of the typical reopen gap
+static const double GAP_FACTOR = 1.5;
+static const int GAP_MARGIN_MS = 100;
+// Consumers remembered, the least recently seen go first
+static const size_t MAX_CONSUMERS = 64;
+
+void StopDelayPolicy::opened(const QString& consumer)
+{
+    QMutexLocker locker(&this->m_mutex);
+
+    const quint64 now = monotonicNanoseconds();
+    Consumer& entry = this->m_consumers[consumer];
+    entry.lastSeen = now;
+
+    // Only opens following a close of the same consumer say anything
+    // about reopening
+    if (entry.lastClosed == 0) {
+        evict();
+        return;
+    }
+
+    const double gapMs = (now - entry.lastClosed) / 1e6;
+    const double reopened = gapMs <= MAX_DELAY_MS ? 1 : 0;
+    entry.lastClosed = 0;
+
+    entry.reopenRate = entry.learned ? entry.reopenRate + LEARNING_RATE * (reopened - entry.reopenRate)
+                                     : reopened;
+    if (reopened)
+        entry.reopenGapMs = entry.reopenGapMs > 0 ? entry.reopenGapMs + LEARNING_RATE * (gapMs - entry.reopenGapMs)
+                                                  : gapMs;
+    entry.learned = true;
+}
+
+int StopDelayPolicy::closed(const QString& consumer)
+{
+    QMutexLocker locker(&this->m_mutex);
+
+    const quint64 now = monotonicNanoseconds();
+    Consumer& entry = this->m_consumers[consumer];
+    entry.lastClosed = now;
+    entry.lastSeen = now;
+    const int delay = delayFor(entry);
+
+    evict();
+    return delay;
+}
+
+int StopDelayPolicy::delayFor(const Consumer& consumer)
+{
+    if (!consumer.learned)
+        return DEFAULT_DELAY_MS;
+
+    if (consumer.reopenRate < REOPEN_THRESHOLD)
+        return MIN_DELAY_MS;
+
+    const int delay = consumer.reopenGapMs * GAP_FACTOR + GAP_MARGIN_MS;
+    if (delay < MIN_DELAY_MS)
+        return MIN_DELAY_MS;
+    return delay < MAX_DELAY_MS ? delay : MAX_DELAY_MS;
+}
+
+void StopDelayPolicy::evict()
+{
+    while ((size_t)this->m_consumers.size() > MAX_CONSUMERS) {
+        auto oldest = this->m_consumers.begin();
+        for (auto it = this->m_consumers.begin(); it != this->m_consumers.end(); ++it) {
+            if (it.value().lastSeen < oldest.value().lastSeen)
+                oldest = it;
+        }
+        this->m_consumers.erase(oldest);
+    }
+}
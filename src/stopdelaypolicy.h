@@ -0,0 +1,43 @@
+#ifndef STOPDELAYPOLICY_H
+#define STOPDELAYPOLICY_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Learns per consumer how soon it comes back after closing a device
+// and picks how long a source keeps running after the last close.
+// Apps that probe the device and reopen it right away keep the sensor
+// going just long enough to catch the reopen, everything else lets it
+// stop quickly. Consumers not seen before get the default delay.
+// Safe to use from any thread.
+class StopDelayPolicy
+{
+public:
+    static const int DEFAULT_DELAY_MS = 3000;
+    static const int MIN_DELAY_MS = 250;
+    static const int MAX_DELAY_MS = 5000;
+
+    void opened(const QString& consumer);
+    // Returns how long to keep running after this close, in ms
+    int closed(const QString& consumer);
+
+private:
+    struct Consumer {
+        quint64 lastClosed = 0;
+        quint64 lastSeen = 0;
+        // Moving averages of the reopen gap and of how often a close
+        // is followed by a reopen within MAX_DELAY_MS
+        double reopenGapMs = 0;
+        double reopenRate = 0;
+        bool learned = false;
+    };
+
+    static int delayFor(const Consumer& consumer);
+    void evict();
+
+    QMutex m_mutex;
+    QHash<QString, Consumer> m_consumers;
+};
+
+#endif // STOPDELAYPOLICY_H
@@ -0,0 +1,264 @@
+#include "syntheticframesource.h"
+
+#include <QDebug>
+#include <QMetaObject>
+
+#include <cstring>
+
+// 75% colour bars, RGBA
+static const uint8_t BARS[][4] = {
+    { 191, 191, 191, 255 },
+    { 191, 191,   0, 255 },
+    {   0, 191, 191, 255 },
+    {   0, 191,   0, 255 },
+    { 191,   0, 191, 255 },
+    { 191,   0,   0, 255 },
+    {   0,   0, 191, 255 },
+    {  16,  16,  16, 255 },
+};
+static const size_t NUMBER_OF_BARS = sizeof(BARS) / sizeof(BARS[0]);
+static const uint8_t WHITE[4] = { 255, 255, 255, 255 };
+
+// Height of the band scrolling down the pattern, in pairs of rows
+static const size_t BAND_PAIRS = 4;
+
+// BT.601 limited range
+static uint8_t luma(const uint8_t* c)
+{
+    return ((66 * c[0] + 129 * c[1] + 25 * c[2] + 128) >> 8) + 16;
+}
+
+static uint8_t cb(const uint8_t* c)
+{
+    return ((-38 * c[0] - 74 * c[1] + 112 * c[2] + 128) >> 8) + 128;
+}
+
+static uint8_t cr(const uint8_t* c)
+{
+    return ((112 * c[0] - 94 * c[1] - 18 * c[2] + 128) >> 8) + 128;
+}
+
+SyntheticFrameSource::SyntheticFrameSource(size_t width, size_t height, int fps,
+                                           PixelFormat format, QObject *parent) :
+    FrameSource(parent),
+    m_width(width),
+    m_height(height),
+    m_fps(fps > 0 ? fps : 30),
+    m_maxWidth(width),
+    m_maxHeight(height),
+    m_format(format)
+{
+    resetPattern();
+
+    this->m_frameTimer.setTimerType(Qt::PreciseTimer);
+    this->m_frameTimer.setInterval(1000 / this->m_fps);
+    QObject::connect(&this->m_frameTimer, &QTimer::timeout,
+                     this, &SyntheticFrameSource::produceFrame);
+
+    qInfo() << "Synthetic source" << this->m_width << this->m_height
+            << pixelFormatName(this->m_format) << "at" << this->m_fps << "fps";
+}
+
+SyntheticFrameSource::~SyntheticFrameSource()
+{
+    this->m_frameTimer.stop();
+}
+
+void SyntheticFrameSource::resetPattern()
+{
+    const size_t frameSize = pixelFormatFrameSize(this->m_format, this->m_width, this->m_height);
+
+    this->m_framePool.reset(new FramePool(frameSize, FramePool::DEFAULT_BUFFER_COUNT + this->m_queueDepth));
+    this->m_pattern.resize(frameSize);
+    for (size_t pair = 0; pair < (this->m_height + 1) / 2; pair++)
+        paintRows(pair, false);
+    this->m_frameCounter = 0;
+}
+
+const uint8_t* SyntheticFrameSource::colourAt(size_t x, bool highlight)
+{
+    return highlight ? WHITE : BARS[x * NUMBER_OF_BARS / this->m_width];
+}
+
+void SyntheticFrameSource::paintRows(size_t pair, bool highlight)
+{
+    uint8_t* frame = (uint8_t*)this->m_pattern.data();
+    const size_t width = this->m_width;
+    const size_t height = this->m_height;
+
+    for (size_t row = pair * 2; row < pair * 2 + 2 && row < height; row++) {
+        for (size_t x = 0; x < width; x++) {
+            const uint8_t* colour = colourAt(x, highlight);
+
+            switch (this->m_format) {
+            case PixelFormat::Rgba32:
+                memcpy(frame + (row * width + x) * 4, colour, 4);
+                break;
+            case PixelFormat::Rgb24:
+                memcpy(frame + (row * width + x) * 3, colour, 3);
+                break;
+            case PixelFormat::Bgr24:
+                frame[(row * width + x) * 3] = colour[2];
+                frame[(row * width + x) * 3 + 1] = colour[1];
+                frame[(row * width + x) * 3 + 2] = colour[0];
+                break;
+            case PixelFormat::Yuyv:
+                frame[row * width * 2 + x * 2] = luma(colour);
+                frame[row * width * 2 + x * 2 + 1] = (x % 2 == 0) ? cb(colour) : cr(colour);
+                break;
+            case PixelFormat::Nv12:
+            case PixelFormat::Nv21:
+            case PixelFormat::I420:
+                frame[row * width + x] = luma(colour);
+                break;
+            case PixelFormat::Mjpeg:
+                // Painted as I420 and encoded by MjpegEncoder
+                break;
+            }
+        }
+    }
+
+    if (this->m_format != PixelFormat::Nv12 && this->m_format != PixelFormat::Nv21
+            && this->m_format != PixelFormat::I420)
+        return;
+
+    uint8_t* chroma = frame + width * height;
+    for (size_t cx = 0; cx < width / 2; cx++) {
+        const uint8_t* colour = colourAt(cx * 2, highlight);
+
+        if (this->m_format == PixelFormat::Nv12) {
+            chroma[pair * width + cx * 2] = cb(colour);
+            chroma[pair * width + cx * 2 + 1] = cr(colour);
+        } else if (this->m_format == PixelFormat::Nv21) {
+            chroma[pair * width + cx * 2] = cr(colour);
+            chroma[pair * width + cx * 2 + 1] = cb(colour);
+        } else {
+            chroma[pair * (width / 2) + cx] = cb(colour);
+            chroma[width * height / 4 + pair * (width / 2) + cx] = cr(colour);
+        }
+    }
+}
+
+size_t SyntheticFrameSource::width()
+{
+    return this->m_width;
+}
+
+size_t SyntheticFrameSource::height()
+{
+    return this->m_height;
+}
+
+PixelFormat SyntheticFrameSource::pixelFormat()
+{
+    return this->m_format;
+}
+
+QVector<VideoFormat> SyntheticFrameSource::supportedFormats()
+{
+    static const QVector<PixelFormat> pixelFormats = {
+        PixelFormat::Rgba32,
+        PixelFormat::Rgb24,
+        PixelFormat::Bgr24,
+        PixelFormat::Yuyv,
+        PixelFormat::Nv12,
+        PixelFormat::Nv21,
+        PixelFormat::I420,
+    };
+
+    return videoFormatLadder(pixelFormats, this->m_maxWidth, this->m_maxHeight);
+}
+
+bool SyntheticFrameSource::setFormat(const VideoFormat& format)
+{
+    if (format == this->format())
+        return true;
+    if (!supportedFormats().contains(format))
+        return false;
+
+    this->m_format = format.pixelFormat;
+    this->m_width = format.width;
+    this->m_height = format.height;
+    resetPattern();
+
+    qInfo() << "Synthetic source switched to" << format;
+    return true;
+}
+
+void SyntheticFrameSource::setQueueDepth(size_t frames)
+{
+    FrameSource::setQueueDepth(frames);
+    resetPattern();
+}
+
+int SyntheticFrameSource::frameRate()
+{
+    return this->m_fps;
+}
+
+bool SyntheticFrameSource::setFrameRate(int fps)
+{
+    if (fps <= 0)
+        return false;
+
+    this->m_fps = fps;
+    this->m_frameTimer.setInterval(1000 / this->m_fps);
+    return true;
+}
+
+void SyntheticFrameSource::start()
+{
+    QMetaObject::invokeMethod(this, "queueStart", Qt::QueuedConnection);
+}
+
+void SyntheticFrameSource::queueStart()
+{
+    qDebug() << "Starting synthetic source";
+    this->m_frameTimer.start();
+}
+
+void SyntheticFrameSource::stop()
+{
+    QMetaObject::invokeMethod(this, "queueStop", Qt::QueuedConnection);
+}
+
+void SyntheticFrameSource::queueStop()
+{
+    qDebug() << "Stopping synthetic source";
+    this->m_frameTimer.stop();
+    qInfo() << this->m_framePool->stats();
+}
+
+void SyntheticFrameSource::requestFrame()
+{
+    produceFrame();
+}
+
+void SyntheticFrameSource::produceFrame()
+{
+    const size_t pairs = (this->m_height + 1) / 2;
+    if (pairs == 0)
+        return;
+
+    // Move the highlighted band down by two rows per frame
+    const size_t previous = this->m_frameCounter % pairs;
+    const size_t next = (previous + BAND_PAIRS) % pairs;
+    paintRows(previous, false);
+    paintRows(next, true);
+    ++this->m_frameCounter;
+    const quint64 timestamp = monotonicNanoseconds();
+    const quint64 sequence = ++this->m_sequence;
+
+    FrameRef frame = this->m_framePool->acquire();
+    if (frame.isNull()) {
+        if (this->m_stats)
+            ++this->m_stats->dropped;
+        return;
+    }
+
+    memcpy(frame.data(), this->m_pattern.constData(), frame.size());
+    frame.setTiming(timestamp, sequence);
+    if (this->m_stats)
+        ++this->m_stats->produced;
+    emit captured(frame);
+}
@@ -0,0 +1,69 @@
+#ifndef SYNTHETICFRAMESOURCE_H
+#define SYNTHETICFRAMESOURCE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QTimer>
+
+#include <memory>
+
+#include "framepool.h"
+#include "framesource.h"
+#include "videoformat.h"
+
+// Produces a moving colour bar test pattern at a fixed rate,
+// for running the pipeline without any camera hardware.
+class SyntheticFrameSource : public FrameSource
+{
+    Q_OBJECT
+
+public:
+    explicit SyntheticFrameSource(size_t width = 1280,
+                                  size_t height = 720,
+                                  int fps = 30,
+                                  PixelFormat format = PixelFormat::Rgba32,
+                                  QObject *parent = nullptr);
+    ~SyntheticFrameSource();
+    void start() override;
+    void stop() override;
+    // Produces one frame right away on the calling thread, timer or not
+    Q_INVOKABLE void requestFrame();
+
+    size_t width() override;
+    size_t height() override;
+    PixelFormat pixelFormat() override;
+
+    int frameRate() override;
+    bool setFrameRate(int fps) override;
+
+    // Any pixel format, at the constructed size or below
+    QVector<VideoFormat> supportedFormats() override;
+    bool setFormat(const VideoFormat& format) override;
+
+    void setQueueDepth(size_t frames) override;
+
+private slots:
+    void queueStart();
+    void queueStop();
+    void produceFrame();
+
+private:
+    const uint8_t* colourAt(size_t x, bool highlight);
+    void paintRows(size_t pair, bool highlight);
+    void resetPattern();
+
+    size_t m_width = 0;
+    size_t m_height = 0;
+    int m_fps = 30;
+    size_t m_maxWidth = 0;
+    size_t m_maxHeight = 0;
+    PixelFormat m_format = PixelFormat::Rgba32;
+    size_t m_frameCounter = 0;
+    // Frames produced since construction, across format changes
+    quint64 m_sequence = 0;
+    QByteArray m_pattern;
+    std::unique_ptr<FramePool> m_framePool;
+    QTimer m_frameTimer;
+};
+
+#endif // SYNTHETICFRAMESOURCE_H
@@ -0,0 +1,80 @@
+#include "transformservice.h"
+
+#include <QDBusConnection>
+#include <QDebug>
+
+const QString TransformService::PATH = QStringLiteral("/org/opticd/Transform");
+
+TransformService::TransformService(QObject *parent) : QObject(parent)
+{
+}
+
+TransformService::~TransformService()
+{
+    QDBusConnection::sessionBus().unregisterObject(PATH);
+}
+
+bool TransformService::registerOnBus()
+{
+    if (!QDBusConnection::sessionBus().registerObject(PATH, this, QDBusConnection::ExportScriptableSlots)) {
+        qWarning() << "Failed to register" << PATH << "on the session bus";
+        return false;
+    }
+    return true;
+}
+
+void TransformService::addBridge(CameraBridge* bridge)
+{
+    this->m_bridges.push_back(bridge);
+}
+
+CameraBridge* TransformService::bridgeOf(const QString& device)
+{
+    for (CameraBridge* bridge : this->m_bridges) {
+        if (bridge->sink()->path() == device)
+            return bridge;
+    }
+    return nullptr;
+}
+
+QStringList TransformService::Devices()
+{
+    QStringList devices;
+    for (CameraBridge* bridge : this->m_bridges)
+        devices.append(bridge->sink()->path());
+    return devices;
+}
+
+QVariantMap TransformService::Transform(const QString& device)
+{
+    CameraBridge* bridge = bridgeOf(device);
+    if (!bridge)
+        return QVariantMap();
+
+    const FrameTransform transform = bridge->transform();
+    QVariantMap map;
+    map.insert(QStringLiteral("rotation"), transform.rotation);
+    map.insert(QStringLiteral("mirror"), transform.mirror);
+    map.insert(QStringLiteral("crop"), transform.crop);
+    map.insert(QStringLiteral("zoom"), (double)transform.zoom);
+    return map;
+}
+
+bool TransformService::SetTransform(const QString& device, const QVariantMap& map)
+{
+    CameraBridge* bridge = bridgeOf(device);
+    if (!bridge)
+        return false;
+
+    FrameTransform transform = bridge->transform();
+    if (map.contains(QStringLiteral("rotation")))
+        transform.rotation = map.value(QStringLiteral("rotation")).toInt();
+    if (map.contains(QStringLiteral("mirror")))
+        transform.mirror = map.value(QStringLiteral("mirror")).toBool();
+    if (map.contains(QStringLiteral("crop")))
+        transform.crop = map.value(QStringLiteral("crop")).toBool();
+    if (map.contains(QStringLiteral("zoom")))
+        transform.zoom = map.value(QStringLiteral("zoom")).toDouble();
+
+    return transform.isValid() && bridge->setTransform(transform);
+}
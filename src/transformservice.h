@@ -0,0 +1,45 @@
+#ifndef TRANSFORMSERVICE_H
+#define TRANSFORMSERVICE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <vector>
+
+#include "camerabridge.h"
+
+// Lets clients on the session bus rotate, mirror, crop and zoom each
+// device's frames, as org.opticd /org/opticd/Transform. Transforms are
+// maps of rotation (int, clockwise degrees), mirror (bool), crop (bool)
+// and zoom (double).
+class TransformService : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.opticd.Transform")
+
+public:
+    static const QString PATH;
+
+    explicit TransformService(QObject *parent = nullptr);
+    ~TransformService();
+
+    // Registers the object on the service StatsService owns
+    bool registerOnBus();
+
+    // Not owned, must outlive the service
+    void addBridge(CameraBridge* bridge);
+
+public slots:
+    Q_SCRIPTABLE QStringList Devices();
+    Q_SCRIPTABLE QVariantMap Transform(const QString& device);
+    // Keys left out keep their current value
+    Q_SCRIPTABLE bool SetTransform(const QString& device, const QVariantMap& transform);
+
+private:
+    CameraBridge* bridgeOf(const QString& device);
+
+    std::vector<CameraBridge*> m_bridges;
+};
+
+#endif // TRANSFORMSERVICE_H
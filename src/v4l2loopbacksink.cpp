@@ -1,31 +1,145 @@
 #include "v4l2loopbacksink.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QThread>
+#include <QMetaObject>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <vector>
 
 #include <fcntl.h>
 #include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
+#include "mjpegencoder.h"
 #include "v4l2loopback.h"
 
 #define CONTROLDEVICE "/dev/v4l2loopback"
+// udev writes a device's database entry once it is done with it
+#define UDEV_DATA_DIR "/run/udev/data"
+
+// Least number of mmap'd output buffers in streaming mode, one is
+// filled while the driver holds the other
+static const unsigned int STREAMING_BUFFER_COUNT = 2;
+
+// How often the rate consumers set with VIDIOC_S_PARM is looked up
+// while frames are written, the driver sends no event for it
+static const int RATE_CHECK_INTERVAL_MS = 250;
+
+// Time udev gets to set up a new node before it is used anyway
+static const int NODE_SETTLE_TIMEOUT_MS = 3000;
+
+static int xioctl(int fd, unsigned long request, void* arg)
+{
+    int ret;
+    do {
+        ret = ioctl(fd, request, arg);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+static bool nodeReady(const QByteArray& node, bool udev)
+{
+    struct stat st;
+    if (stat(node.data(), &st) < 0 || access(node.data(), R_OK | W_OK) < 0)
+        return false;
+    if (!udev)
+        return true;
+
+    char entry[64];
+    snprintf(entry, sizeof(entry), UDEV_DATA_DIR "/c%u:%u", major(st.st_rdev), minor(st.st_rdev));
+    return access(entry, F_OK) == 0;
+}
+
+// Blocks until the node is accessible and, where udev runs, udev handled
+// it. Woken by inotify on both directories instead of sleeping blindly.
+static bool waitForNode(const QString& path, int timeoutMs)
+{
+    const QByteArray node = path.toUtf8();
+    const bool udev = access(UDEV_DATA_DIR, F_OK) == 0;
+
+    // Watches go in before the first check so no change slips through
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0) {
+        const uint32_t mask = IN_CREATE | IN_ATTRIB | IN_MOVED_TO;
+        if (inotify_add_watch(fd, "/dev", mask) < 0
+                || (udev && inotify_add_watch(fd, UDEV_DATA_DIR, mask) < 0)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ready;
+    while (!(ready = nodeReady(node, udev))) {
+        const qint64 remaining = timeoutMs - timer.elapsed();
+        if (remaining <= 0)
+            break;
+
+        // Without inotify the checks are just spaced out
+        if (fd < 0) {
+            usleep(10000);
+            continue;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, remaining) > 0) {
+            char events[4096];
+            while (read(fd, events, sizeof(events)) > 0) {}
+        }
+    }
+
+    if (fd >= 0)
+        close(fd);
+    return ready;
+}
+
+class V4L2LoopbackWriter : public QThread
+{
+public:
+    explicit V4L2LoopbackWriter(V4L2LoopbackSink* sink) : m_sink(sink) {}
+
+protected:
+    void run() override { this->m_sink->drainQueue(); }
+
+private:
+    V4L2LoopbackSink* m_sink;
+};
 
 V4L2LoopbackSink::V4L2LoopbackSink(size_t width,
                                    size_t height,
+                                   PixelFormat format,
                                    QString description,
                                    QObject *parent) : QObject(parent),
     m_description(description),
     m_width(width),
-    m_height(height)
+    m_height(height),
+    m_format(format),
+    m_supportedFormats({ VideoFormat(format, width, height) }),
+    m_buffering(bufferingSettings(BufferingProfile::LowLatency))
 {
-    qInfo() << m_description << m_width << m_height;
+    qInfo() << m_description << m_width << m_height << pixelFormatName(m_format);
+
+    QObject::connect(&this->m_pacer, &FramePacer::frameDue,
+                     this, &V4L2LoopbackSink::queueFrame, Qt::DirectConnection);
 }
 
 V4L2LoopbackSink::~V4L2LoopbackSink()
 {
+    // Ticks write straight to the device
+    this->m_pacer.stop();
+    stopWriter();
     deleteLoopbackDevice();
 }
 
@@ -42,9 +156,14 @@ void V4L2LoopbackSink::addLoopbackDevice()
     cfg.capture_nr = -1;
     cfg.output_nr = -1;
     cfg.announce_all_caps = 0;
+    // Large enough for every format the source can switch to
     cfg.max_width = this->m_width;
     cfg.max_height = this->m_height;
-    cfg.max_buffers = 1;
+    for (const VideoFormat& format : this->m_supportedFormats) {
+        cfg.max_width = std::max<int>(cfg.max_width, format.width);
+        cfg.max_height = std::max<int>(cfg.max_height, format.height);
+    }
+    cfg.max_buffers = deviceBufferCount();
     cfg.max_openers = 32;
 
     int ret = ioctl(fd, V4L2LOOPBACK_CTL_ADD, &cfg);
@@ -56,13 +175,20 @@ void V4L2LoopbackSink::addLoopbackDevice()
 
     this->m_path = QStringLiteral("/dev/video%1").arg(ret);
     this->m_deviceNumber = ret;
-    this->m_vidsendsiz = this->m_width * this->m_height * 4;
+    this->m_vidsendsiz = pixelFormatFrameSize(this->m_format, this->m_width, this->m_height);
     close(fd);
 
+    resetDummyFrame();
+
     qInfo("v4l2sink device '%s' created", this->m_path.toUtf8().data());
 
     // Let udev settle
-    QThread::sleep(1);
+    QElapsedTimer timer;
+    timer.start();
+    if (waitForNode(this->m_path, NODE_SETTLE_TIMEOUT_MS))
+        qInfo("%s ready after %lld ms", this->m_path.toUtf8().data(), timer.elapsed());
+    else
+        qWarning("%s not set up by udev after %d ms", this->m_path.toUtf8().data(), NODE_SETTLE_TIMEOUT_MS);
 
     emit deviceCreated(this->m_path);
 }
@@ -75,6 +201,8 @@ void V4L2LoopbackSink::deleteLoopbackDevice()
         return;
     }
 
+    teardownStreaming();
+
     if (close(this->m_sinkFd) != 0) {
         qWarning("Failed to close video node");
         return;
@@ -98,6 +226,18 @@ void V4L2LoopbackSink::openLoopbackDevice()
         return;
     }
 
+    applyFormat();
+    applyFrameRate();
+
+    if (this->m_ioMode == StreamingIo && !setupStreaming()) {
+        qWarning("Streaming I/O refused for %s, falling back to write()", this->m_path.toUtf8().data());
+        teardownStreaming();
+        this->m_ioMode = WriteIo;
+    }
+}
+
+bool V4L2LoopbackSink::applyFormat()
+{
     // setup video for proper format
     struct v4l2_format v;
     int t;
@@ -106,38 +246,549 @@ void V4L2LoopbackSink::openLoopbackDevice()
     t = ioctl(this->m_sinkFd, VIDIOC_G_FMT, &v);
     if (t < 0) {
         qWarning("Failed to get current v4l2 sink format");
-        return;
+        return false;
     }
 
     v.fmt.pix.width = this->m_width;
     v.fmt.pix.height = this->m_height;
-    v.fmt.pix.pixelformat = V4L2_PIX_FMT_RGBA32;
+    v.fmt.pix.pixelformat = pixelFormatFourCC(this->m_format);
+    v.fmt.pix.bytesperline = pixelFormatBytesPerLine(this->m_format, this->m_width);
     v.fmt.pix.sizeimage = this->m_vidsendsiz;
+    v.fmt.pix.field = V4L2_FIELD_NONE;
     t = ioctl(this->m_sinkFd, VIDIOC_S_FMT, &v);
     if (t < 0) {
         qWarning("Failed to set proper v4l2 sink format");
+        return false;
+    }
+
+    // The driver answers with the format it kept
+    if (v.fmt.pix.pixelformat != pixelFormatFourCC(this->m_format)
+            || (int)v.fmt.pix.width != this->m_width || (int)v.fmt.pix.height != this->m_height) {
+        qWarning("v4l2 sink kept format %ux%u", v.fmt.pix.width, v.fmt.pix.height);
+        return false;
+    }
+    return true;
+}
+
+void V4L2LoopbackSink::applyFrameRate()
+{
+    if (this->m_fps <= 0)
+        return;
+
+    struct v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    parm.parm.output.timeperframe.numerator = 1;
+    parm.parm.output.timeperframe.denominator = this->m_fps;
+    if (ioctl(this->m_sinkFd, VIDIOC_S_PARM, &parm) < 0)
+        qWarning("Failed to set v4l2 sink frame rate: %s", strerror(errno));
+}
+
+void V4L2LoopbackSink::setSupportedFormats(const QVector<VideoFormat>& formats)
+{
+    this->m_supportedFormats = formats;
+    qInfo() << this->m_description << "offers" << formats.size() << "formats";
+}
+
+QVector<VideoFormat> V4L2LoopbackSink::supportedFormats()
+{
+    return this->m_supportedFormats;
+}
+
+VideoFormat V4L2LoopbackSink::format()
+{
+    return VideoFormat(this->m_format, this->m_width, this->m_height);
+}
+
+bool V4L2LoopbackSink::setFormat(const VideoFormat& format)
+{
+    QMutexLocker locker(&this->m_deviceMutex);
+
+    if (format == this->format())
+        return true;
+
+    const VideoFormat previous = this->format();
+    const bool streaming = !this->m_buffers.empty();
+    this->m_pacer.reset();
+    clearQueue();
+    teardownStreaming();
+
+    this->m_format = format.pixelFormat;
+    this->m_width = format.width;
+    this->m_height = format.height;
+    this->m_vidsendsiz = format.frameSize();
+
+    bool success = applyFormat();
+    if (!success) {
+        this->m_format = previous.pixelFormat;
+        this->m_width = previous.width;
+        this->m_height = previous.height;
+        this->m_vidsendsiz = previous.frameSize();
+        applyFormat();
+    }
+
+    resetDummyFrame();
+    if (streaming && !setupStreaming()) {
+        qWarning("Streaming I/O refused for %s, falling back to write()", this->m_path.toUtf8().data());
+        teardownStreaming();
+        this->m_ioMode = WriteIo;
+    }
+
+    if (success)
+        qInfo() << this->m_path << "now" << format;
+    return success;
+}
+
+void V4L2LoopbackSink::setFrameRate(int fps)
+{
+    QMutexLocker locker(&this->m_deviceMutex);
+
+    this->m_fps = fps > 0 ? fps : 0;
+    this->m_pacer.setFrameRate(this->m_pacing ? this->m_fps : 0);
+    if (this->m_sinkFd >= 0)
+        applyFrameRate();
+
+    qInfo() << this->m_path << "at" << this->m_fps << "fps" << (this->m_pacing ? "paced" : "unpaced");
+}
+
+int V4L2LoopbackSink::frameRate()
+{
+    return this->m_fps;
+}
+
+void V4L2LoopbackSink::setPacing(bool enabled)
+{
+    QMutexLocker locker(&this->m_deviceMutex);
+
+    this->m_pacing = enabled;
+    this->m_pacer.setFrameRate(this->m_pacing ? this->m_fps : 0);
+}
+
+void V4L2LoopbackSink::setStats(std::shared_ptr<PipelineStats> stats)
+{
+    QMutexLocker locker(&this->m_deviceMutex);
+
+    this->m_stats = stats;
+    this->m_pacer.setPipelineStats(stats);
+    if (this->m_stats)
+        this->m_stats->setBufferingProfile(bufferingProfileName(this->m_profile));
+}
+
+void V4L2LoopbackSink::deviceOpened()
+{
+    QMetaObject::invokeMethod(this, "greetConsumer", Qt::QueuedConnection);
+}
+
+void V4L2LoopbackSink::greetConsumer()
+{
+    // The driver pins the format once the output side has written, so
+    // consumers take the device's format as is. Only rates are shared
+    // between both sides of the loopback device, the rate is looked up
+    // again with the frame written next.
+    {
+        QMutexLocker locker(&this->m_deviceMutex);
+        this->m_rateCheckedAt = 0;
     }
+    feedLastFrame();
+}
+
+int V4L2LoopbackSink::consumerFrameRate()
+{
+    struct v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    if (this->m_sinkFd < 0 || ioctl(this->m_sinkFd, VIDIOC_G_PARM, &parm) < 0)
+        return 0;
+
+    const v4l2_fract& timeperframe = parm.parm.output.timeperframe;
+    if (timeperframe.numerator == 0)
+        return 0;
+    return (timeperframe.denominator + timeperframe.numerator / 2) / timeperframe.numerator;
+}
+
+void V4L2LoopbackSink::resetDummyFrame()
+{
+    // Black frame kept around for feeding new openers, frames of the
+    // previous format don't fit anymore
+    this->m_lastFrame.reset();
+    this->m_dummyFrame.reset();
+    this->m_dummyPool.reset(new FramePool(this->m_vidsendsiz, 1));
+    this->m_dummyFrame = this->m_dummyPool->acquire();
+    fillBlack(this->m_dummyFrame);
 }
 
-void V4L2LoopbackSink::pushCapture(QByteArray capture)
+bool V4L2LoopbackSink::setupStreaming()
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = deviceBufferCount();
+    req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    req.memory = V4L2_MEMORY_MMAP;
+
+    if (xioctl(this->m_sinkFd, VIDIOC_REQBUFS, &req) < 0) {
+        qWarning("VIDIOC_REQBUFS failed: %s", strerror(errno));
+        return false;
+    }
+
+    if (req.count == 0) {
+        qWarning("VIDIOC_REQBUFS granted no buffers");
+        return false;
+    }
+
+    this->m_buffers.resize(req.count);
+    for (unsigned int i = 0; i < req.count; i++) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.index = i;
+        buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        buf.memory = V4L2_MEMORY_MMAP;
+
+        if (xioctl(this->m_sinkFd, VIDIOC_QUERYBUF, &buf) < 0) {
+            qWarning("VIDIOC_QUERYBUF failed: %s", strerror(errno));
+            return false;
+        }
+
+        if (buf.length < (unsigned int)this->m_vidsendsiz) {
+            qWarning("Output buffer %u too small: %u < %d", i, buf.length, this->m_vidsendsiz);
+            return false;
+        }
+
+        void* data = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          this->m_sinkFd, buf.m.offset);
+        if (data == MAP_FAILED) {
+            qWarning("Failed to map output buffer %u: %s", i, strerror(errno));
+            return false;
+        }
+
+        this->m_buffers[i].data = data;
+        this->m_buffers[i].length = buf.length;
+        this->m_buffers[i].queued = false;
+    }
+
+    qInfo("Streaming I/O with %u buffers on %s", req.count, this->m_path.toUtf8().data());
+    return true;
+}
+
+void V4L2LoopbackSink::teardownStreaming()
+{
+    if (this->m_streaming) {
+        int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        if (xioctl(this->m_sinkFd, VIDIOC_STREAMOFF, &type) < 0)
+            qWarning("VIDIOC_STREAMOFF failed: %s", strerror(errno));
+        this->m_streaming = false;
+    }
+
+    for (MappedBuffer& buffer : this->m_buffers) {
+        if (buffer.data)
+            munmap(buffer.data, buffer.length);
+    }
+
+    if (!this->m_buffers.empty()) {
+        this->m_buffers.clear();
+
+        struct v4l2_requestbuffers req;
+        memset(&req, 0, sizeof(req));
+        req.count = 0;
+        req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        req.memory = V4L2_MEMORY_MMAP;
+        xioctl(this->m_sinkFd, VIDIOC_REQBUFS, &req);
+    }
+}
+
+void V4L2LoopbackSink::pushCapture(FrameRef capture)
 {
     //qDebug("Pushing capture");
-    if (int written = write(this->m_sinkFd, capture.data(), capture.size()) != m_vidsendsiz) {
-        qWarning("Failed to push captured frame, wrote %d/%d bytes, capture size %d", written, m_vidsendsiz, capture.size());
+    this->m_pacer.submit(capture);
+}
+
+void V4L2LoopbackSink::queueFrame(FrameRef frame)
+{
+    if (!this->m_writer) {
+        writeFrame(frame);
+        return;
+    }
+
+    QMutexLocker locker(&this->m_queueMutex);
+    if (this->m_queue.size() >= this->m_buffering.queueDepth) {
+        if (this->m_stats) {
+            ++this->m_stats->dropped;
+            ++this->m_stats->queueDropped;
+        }
+        if (this->m_buffering.dropPolicy == BufferingSettings::DropNewest)
+            return;
+        this->m_queue.pop_front();
+    }
+
+    this->m_queue.push_back(frame);
+    this->m_frameQueued.wakeOne();
+}
+
+void V4L2LoopbackSink::drainQueue()
+{
+    for (;;) {
+        FrameRef frame;
+        {
+            QMutexLocker locker(&this->m_queueMutex);
+            while (this->m_queue.empty() && !this->m_quit)
+                this->m_frameQueued.wait(&this->m_queueMutex);
+            if (this->m_quit)
+                return;
+
+            frame = this->m_queue.front();
+            this->m_queue.pop_front();
+        }
+
+        writeFrame(frame);
+    }
+}
+
+void V4L2LoopbackSink::stopWriter()
+{
+    if (!this->m_writer)
+        return;
+
+    {
+        QMutexLocker locker(&this->m_queueMutex);
+        this->m_quit = true;
+        this->m_frameQueued.wakeAll();
     }
+    this->m_writer->wait();
+    delete this->m_writer;
+    this->m_writer = nullptr;
+    clearQueue();
 }
 
-void V4L2LoopbackSink::feedDummyFrame()
+void V4L2LoopbackSink::clearQueue()
 {
-    QByteArray fummy;
-    fummy.resize(this->m_vidsendsiz);
-    pushCapture(fummy);
+    QMutexLocker locker(&this->m_queueMutex);
+    this->m_queue.clear();
+}
+
+void V4L2LoopbackSink::writeFrame(FrameRef capture)
+{
+    if (capture.isNull())
+        return;
+
+    QMutexLocker locker(&this->m_deviceMutex);
+
+    // Frames still in the previous format after a switch are dropped,
+    // compressed frames only have an upper bound
+    if (pixelFormatIsCompressed(this->m_format) ? capture.size() > (size_t)this->m_vidsendsiz
+                                                : capture.size() != (size_t)this->m_vidsendsiz) {
+        if (this->m_stats)
+            ++this->m_stats->dropped;
+        return;
+    }
+
+    bool success;
+    {
+        StageTimer timer(this->m_stats, PipelineStats::Write);
+        success = this->m_ioMode == StreamingIo ? pushStreaming(capture) : pushWrite(capture);
+    }
+    if (!success)
+        return;
+
+    if (capture.data() != this->m_dummyFrame.data())
+        this->m_lastFrame = capture;
+    if (this->m_stats) {
+        this->m_stats->frameWritten();
+
+        const uint64_t timestamp = capture.timestamp();
+        if (timestamp && capture.sequence() != this->m_lastSequence
+                && monotonicNanoseconds() - timestamp > (quint64)this->m_buffering.lateAfterMs * 1000000)
+            ++this->m_stats->late;
+    }
+    this->m_lastSequence = capture.sequence();
+
+    // Consumers may change the rate at any time while streaming. The
+    // request is announced outside the lock, as the bridge may apply it
+    // on this thread and reconfigure the sink.
+    const uint64_t now = monotonicNanoseconds();
+    if (now - this->m_rateCheckedAt < (uint64_t)RATE_CHECK_INTERVAL_MS * 1000000)
+        return;
+    this->m_rateCheckedAt = now;
+
+    const int requestedFps = consumerFrameRate();
+    if (requestedFps <= 0 || requestedFps == this->m_fps || requestedFps == this->m_requestedFps)
+        return;
+    this->m_requestedFps = requestedFps;
+    locker.unlock();
+
+    qInfo() << this->m_path << "consumer asked for" << requestedFps << "fps";
+    emit frameRateRequested(requestedFps);
+}
+
+bool V4L2LoopbackSink::pushWrite(const FrameRef& capture)
+{
+    const ssize_t written = write(this->m_sinkFd, capture.data(), capture.size());
+    if (written != (ssize_t)capture.size()) {
+        qWarning("Failed to push captured frame, wrote %zd/%zu bytes", written, capture.size());
+        if (this->m_stats)
+            ++this->m_stats->shortWrites;
+        return false;
+    }
+    return true;
+}
+
+bool V4L2LoopbackSink::pushStreaming(const FrameRef& capture)
+{
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    buf.memory = V4L2_MEMORY_MMAP;
+
+    // Use buffers never handed to the driver first, then recycle
+    // the oldest one the driver is done with.
+    unsigned int index = 0;
+    while (index < this->m_buffers.size() && this->m_buffers[index].queued)
+        index++;
+
+    if (index == this->m_buffers.size()) {
+        if (xioctl(this->m_sinkFd, VIDIOC_DQBUF, &buf) < 0) {
+            qWarning("VIDIOC_DQBUF failed: %s", strerror(errno));
+            return false;
+        }
+        index = buf.index;
+        this->m_buffers[index].queued = false;
+    }
+
+    MappedBuffer& buffer = this->m_buffers[index];
+    const size_t length = capture.size() < buffer.length ? capture.size() : buffer.length;
+    memcpy(buffer.data, capture.data(), length);
+    if (length < capture.size() && this->m_stats)
+        ++this->m_stats->shortWrites;
+
+    buf.index = index;
+    buf.bytesused = length;
+    buf.field = V4L2_FIELD_NONE;
+
+    // The driver passes a set timestamp on to consumers and stamps the
+    // buffer itself if it is zero, as for the black frame
+    const uint64_t timestamp = capture.timestamp();
+    buf.flags = timestamp ? V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC : 0;
+    buf.timestamp.tv_sec = timestamp / 1000000000ULL;
+    buf.timestamp.tv_usec = timestamp % 1000000000ULL / 1000;
+    buf.sequence = capture.sequence();
+    if (xioctl(this->m_sinkFd, VIDIOC_QBUF, &buf) < 0) {
+        qWarning("VIDIOC_QBUF failed: %s", strerror(errno));
+        return false;
+    }
+    buffer.queued = true;
+
+    if (!this->m_streaming) {
+        int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+        if (xioctl(this->m_sinkFd, VIDIOC_STREAMON, &type) < 0) {
+            qWarning("VIDIOC_STREAMON failed: %s", strerror(errno));
+            return false;
+        }
+        this->m_streaming = true;
+    }
+    return length == capture.size();
+}
+
+void V4L2LoopbackSink::fillBlack(FrameRef& frame)
+{
+    if (frame.isNull())
+        return;
+
+    uint8_t* data = frame.data();
+    const size_t lumaSize = this->m_width * this->m_height;
+
+    switch (this->m_format) {
+    case PixelFormat::Rgba32:
+    case PixelFormat::Rgb24:
+    case PixelFormat::Bgr24:
+        memset(data, 0, frame.size());
+        break;
+    case PixelFormat::Yuyv:
+        for (size_t i = 0; i + 1 < frame.size(); i += 2) {
+            data[i] = 16;
+            data[i + 1] = 128;
+        }
+        break;
+    case PixelFormat::Nv12:
+    case PixelFormat::Nv21:
+    case PixelFormat::I420:
+        memset(data, 16, lumaSize);
+        memset(data + lumaSize, 128, frame.size() - lumaSize);
+        break;
+    case PixelFormat::Mjpeg: {
+        std::vector<uint8_t> black(pixelFormatFrameSize(PixelFormat::I420, this->m_width, this->m_height));
+        memset(black.data(), 16, lumaSize);
+        memset(black.data() + lumaSize, 128, black.size() - lumaSize);
+
+        MjpegCompressor compressor;
+        frame.setSize(compressor.compress(black.data(), this->m_width, this->m_height,
+                                          MjpegEncoder::DEFAULT_QUALITY, data, frame.capacity()));
+        break;
+    }
+    }
+}
+
+void V4L2LoopbackSink::feedLastFrame()
+{
+    FrameRef frame;
+    {
+        QMutexLocker locker(&this->m_deviceMutex);
+        frame = this->m_lastFrame.isNull() ? this->m_dummyFrame : this->m_lastFrame;
+    }
+
+    // Goes out right away, the pacer only carries source frames
+    writeFrame(frame);
+}
+
+void V4L2LoopbackSink::setIoMode(IoMode mode)
+{
+    this->m_ioMode = mode;
+}
+
+V4L2LoopbackSink::IoMode V4L2LoopbackSink::ioMode()
+{
+    return this->m_ioMode;
+}
+
+void V4L2LoopbackSink::setBufferingProfile(BufferingProfile profile)
+{
+    this->m_profile = profile;
+    this->m_buffering = bufferingSettings(profile);
+    if (this->m_stats)
+        this->m_stats->setBufferingProfile(bufferingProfileName(profile));
+}
+
+BufferingProfile V4L2LoopbackSink::bufferingProfile()
+{
+    return this->m_profile;
+}
+
+unsigned int V4L2LoopbackSink::deviceBufferCount()
+{
+    if (this->m_ioMode == StreamingIo && this->m_buffering.deviceBuffers < STREAMING_BUFFER_COUNT)
+        return STREAMING_BUFFER_COUNT;
+    return this->m_buffering.deviceBuffers;
+}
+
+bool V4L2LoopbackSink::isOpen()
+{
+    return this->m_sinkFd >= 0;
+}
+
+QString V4L2LoopbackSink::path()
+{
+    return this->m_path;
 }
 
 void V4L2LoopbackSink::run()
 {
     addLoopbackDevice();
     openLoopbackDevice();
-    feedDummyFrame();
+    feedLastFrame();
+
+    if (this->m_sinkFd >= 0 && this->m_buffering.queueDepth > 0 && !this->m_writer) {
+        this->m_writer = new V4L2LoopbackWriter(this);
+        this->m_writer->start();
+    }
+    qInfo("%s buffering %s: %u device buffers, %zu queued frames", this->m_path.toUtf8().data(),
+          bufferingProfileName(this->m_profile).toUtf8().data(), deviceBufferCount(),
+          this->m_buffering.queueDepth);
 }
 
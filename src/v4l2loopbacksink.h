@@ -1,39 +1,155 @@
 #ifndef V4L2LOOPBACKSINK_H
 #define V4L2LOOPBACKSINK_H
 
+#include <QMutex>
 #include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "bufferingprofile.h"
+#include "framepacer.h"
+#include "framepool.h"
+#include "pipelinestats.h"
+#include "videoformat.h"
 
 class V4L2LoopbackSink : public QObject
 {
     Q_OBJECT
 public:
+    enum IoMode {
+        // Plain write() per frame
+        WriteIo,
+        // mmap'd output buffers, falls back to WriteIo if refused
+        StreamingIo
+    };
+
     explicit V4L2LoopbackSink(size_t width = 0,
                               size_t height = 0,
+                              PixelFormat format = PixelFormat::Rgba32,
                               QString description = QStringLiteral("null"),
                               QObject *parent = nullptr);
     ~V4L2LoopbackSink();
 
-    void pushCapture(QByteArray capture);
+    void pushCapture(FrameRef capture);
+    // Adds and opens the device, blocking until udev set it up. May run
+    // on another thread as long as nothing else uses the sink meanwhile.
     void run();
+    // Whether run() got a device to write to
+    bool isOpen();
+    // Device node run() created, empty before
+    QString path();
+
+    void setIoMode(IoMode mode);
+    IoMode ioMode();
+
+    // Device buffers, writer queue and drop policy, call before run()
+    void setBufferingProfile(BufferingProfile profile);
+    BufferingProfile bufferingProfile();
 
-    void feedDummyFrame();
+    // Formats the source can switch to, the largest one sizes the device
+    void setSupportedFormats(const QVector<VideoFormat>& formats);
+    QVector<VideoFormat> supportedFormats();
+    VideoFormat format();
+    // Reformats the device, false if the driver keeps another format
+    bool setFormat(const VideoFormat& format);
+    // Rate advertised to consumers and, with pacing, the rate frames
+    // are written at whatever the source delivers
+    void setFrameRate(int fps);
+    int frameRate();
+    void setPacing(bool enabled);
+
+    // Where write timings and frame counts go
+    void setStats(std::shared_ptr<PipelineStats> stats);
+
+    // Writes the last frame the source delivered, black before the first
+    // one and after format changes
+    void feedLastFrame();
+    // Called when a consumer opens the device, from any thread. It gets
+    // the last frame right away, and its frame rate is picked up.
+    void deviceOpened();
+
+private slots:
+    void greetConsumer();
+    void queueFrame(FrameRef frame);
+    void writeFrame(FrameRef frame);
 
 private:
+    friend class V4L2LoopbackWriter;
+
+    // Writes queued frames until stopWriter(), on m_writer
+    void drainQueue();
+    void stopWriter();
+    void clearQueue();
+    unsigned int deviceBufferCount();
     void addLoopbackDevice();
     void openLoopbackDevice();
     void deleteLoopbackDevice();
+    bool applyFormat();
+    void applyFrameRate();
+    // Rate last set on either side of the device, 0 if unknown
+    int consumerFrameRate();
+    void resetDummyFrame();
+    void fillBlack(FrameRef& frame);
+    bool setupStreaming();
+    void teardownStreaming();
+    bool pushStreaming(const FrameRef& capture);
+    bool pushWrite(const FrameRef& capture);
+
+    struct MappedBuffer {
+        void* data = nullptr;
+        size_t length = 0;
+        bool queued = false;
+    };
 
     QString m_path;
     QString m_description;
     int m_width = 0;
     int m_height = 0;
+    PixelFormat m_format = PixelFormat::Rgba32;
     int m_deviceNumber = 0;
     int m_sinkFd = -1;
     int m_vidsendsiz = 0;
+    IoMode m_ioMode = StreamingIo;
+    bool m_streaming = false;
+    std::vector<MappedBuffer> m_buffers;
+    std::unique_ptr<FramePool> m_dummyPool;
+    FrameRef m_dummyFrame;
+    // Held on to so new openers see a picture before the source restarts
+    FrameRef m_lastFrame;
+    QVector<VideoFormat> m_supportedFormats;
+    int m_fps = 0;
+    bool m_pacing = true;
+    FramePacer m_pacer;
+    BufferingProfile m_profile = BufferingProfile::LowLatency;
+    BufferingSettings m_buffering;
+    // Frames due but not yet written, served by m_writer if the profile
+    // has a writer queue
+    QThread* m_writer = nullptr;
+    QMutex m_queueMutex;
+    QWaitCondition m_frameQueued;
+    std::deque<FrameRef> m_queue;
+    bool m_quit = false;
+    // Repeated frames aren't late, only their first write counts
+    uint64_t m_lastSequence = 0;
+    // When the consumer's rate was last looked up, and the rate last
+    // announced so a pending request isn't repeated
+    uint64_t m_rateCheckedAt = 0;
+    int m_requestedFps = 0;
+    std::shared_ptr<PipelineStats> m_stats;
+    // Guards the device and format against frames pushed from the
+    // source's thread while reformatting
+    QMutex m_deviceMutex;
 
 signals:
     void deviceCreated(const QString path);
     void deviceRemoved(const QString path);
+    // A consumer asked for another frame rate through VIDIOC_S_PARM
+    void frameRateRequested(int fps);
 
 };
 
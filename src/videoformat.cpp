@@ -0,0 +1,214 @@
+#include "videoformat.h"
+
+#include <QStringList>
+
+#include <linux/videodev2.h>
+
+uint32_t pixelFormatFourCC(PixelFormat format)
+{
+    switch (format) {
+    case PixelFormat::Rgba32:
+        return V4L2_PIX_FMT_RGBA32;
+    case PixelFormat::Rgb24:
+        return V4L2_PIX_FMT_RGB24;
+    case PixelFormat::Bgr24:
+        return V4L2_PIX_FMT_BGR24;
+    case PixelFormat::Yuyv:
+        return V4L2_PIX_FMT_YUYV;
+    case PixelFormat::Nv12:
+        return V4L2_PIX_FMT_NV12;
+    case PixelFormat::Nv21:
+        return V4L2_PIX_FMT_NV21;
+    case PixelFormat::I420:
+        return V4L2_PIX_FMT_YUV420;
+    case PixelFormat::Mjpeg:
+        return V4L2_PIX_FMT_MJPEG;
+    }
+    return 0;
+}
+
+size_t pixelFormatFrameSize(PixelFormat format, size_t width, size_t height)
+{
+    switch (format) {
+    case PixelFormat::Rgba32:
+        return width * height * 4;
+    case PixelFormat::Rgb24:
+    case PixelFormat::Bgr24:
+        return width * height * 3;
+    case PixelFormat::Yuyv:
+        return width * height * 2;
+    case PixelFormat::Nv12:
+    case PixelFormat::Nv21:
+    case PixelFormat::I420:
+        return width * height * 3 / 2;
+    case PixelFormat::Mjpeg:
+        // 4:2:0 JPEG at sane quality settings stays well below this
+        return width * height * 2;
+    }
+    return 0;
+}
+
+size_t pixelFormatBytesPerLine(PixelFormat format, size_t width)
+{
+    switch (format) {
+    case PixelFormat::Rgba32:
+        return width * 4;
+    case PixelFormat::Rgb24:
+    case PixelFormat::Bgr24:
+        return width * 3;
+    case PixelFormat::Yuyv:
+        return width * 2;
+    case PixelFormat::Nv12:
+    case PixelFormat::Nv21:
+    case PixelFormat::I420:
+        return width;
+    case PixelFormat::Mjpeg:
+        return 0;
+    }
+    return 0;
+}
+
+bool pixelFormatIsCompressed(PixelFormat format)
+{
+    return format == PixelFormat::Mjpeg;
+}
+
+bool pixelFormatSupportsSize(PixelFormat format, size_t width, size_t height)
+{
+    if (width == 0 || height == 0)
+        return false;
+
+    // GPU conversion packs 2 (YUYV) or 4 (planar) bytes into each RGBA texel,
+    // I420 additionally stores two half-width chroma lines per texel row.
+    // The remaining formats are only converted on the CPU.
+    switch (format) {
+    case PixelFormat::Rgba32:
+    case PixelFormat::Rgb24:
+    case PixelFormat::Bgr24:
+        return true;
+    case PixelFormat::Yuyv:
+        return width % 2 == 0;
+    case PixelFormat::Nv12:
+        return width % 4 == 0 && height % 2 == 0;
+    case PixelFormat::Nv21:
+        return width % 2 == 0 && height % 2 == 0;
+    case PixelFormat::I420:
+        return width % 8 == 0 && height % 4 == 0;
+    case PixelFormat::Mjpeg:
+        // Encoded from I420 in whole 16 pixel wide MCUs
+        return width % 16 == 0 && height % 4 == 0;
+    }
+    return false;
+}
+
+QString pixelFormatName(PixelFormat format)
+{
+    switch (format) {
+    case PixelFormat::Rgba32:
+        return QStringLiteral("rgba");
+    case PixelFormat::Rgb24:
+        return QStringLiteral("rgb24");
+    case PixelFormat::Bgr24:
+        return QStringLiteral("bgr24");
+    case PixelFormat::Yuyv:
+        return QStringLiteral("yuyv");
+    case PixelFormat::Nv12:
+        return QStringLiteral("nv12");
+    case PixelFormat::Nv21:
+        return QStringLiteral("nv21");
+    case PixelFormat::I420:
+        return QStringLiteral("i420");
+    case PixelFormat::Mjpeg:
+        return QStringLiteral("mjpeg");
+    }
+    return QString();
+}
+
+static const PixelFormat ALL_FORMATS[] = {
+    PixelFormat::Rgba32,
+    PixelFormat::Rgb24,
+    PixelFormat::Bgr24,
+    PixelFormat::Yuyv,
+    PixelFormat::Nv12,
+    PixelFormat::Nv21,
+    PixelFormat::I420,
+    PixelFormat::Mjpeg,
+};
+
+// Offered below the source's own size
+static const size_t LADDER_SIZES[][2] = {
+    { 3840, 2160 },
+    { 2560, 1440 },
+    { 1920, 1080 },
+    { 1280, 720 },
+    { 960, 540 },
+    { 640, 480 },
+    { 320, 240 },
+};
+
+bool parsePixelFormat(const QString& name, PixelFormat* format)
+{
+    for (const PixelFormat candidate : ALL_FORMATS) {
+        if (pixelFormatName(candidate) == name.toLower()) {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool pixelFormatFromFourCC(uint32_t fourcc, PixelFormat* format)
+{
+    for (const PixelFormat candidate : ALL_FORMATS) {
+        if (pixelFormatFourCC(candidate) == fourcc) {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseFrameSize(const QString& value, size_t* width, size_t* height)
+{
+    const QStringList parts = value.split(QLatin1Char('x'));
+    if (parts.size() != 2)
+        return false;
+
+    bool widthOk, heightOk;
+    const uint w = parts[0].toUInt(&widthOk);
+    const uint h = parts[1].toUInt(&heightOk);
+    if (!widthOk || !heightOk || w == 0 || h == 0)
+        return false;
+
+    *width = w;
+    *height = h;
+    return true;
+}
+
+QDebug operator<<(QDebug debug, const VideoFormat& format)
+{
+    debug.nospace() << pixelFormatName(format.pixelFormat) << " " << format.width << "x" << format.height;
+    return debug.space();
+}
+
+QVector<VideoFormat> videoFormatLadder(const QVector<PixelFormat>& pixelFormats,
+                                       size_t maxWidth, size_t maxHeight)
+{
+    QVector<VideoFormat> formats;
+
+    for (const PixelFormat pixelFormat : pixelFormats) {
+        if (pixelFormatSupportsSize(pixelFormat, maxWidth, maxHeight))
+            formats.append(VideoFormat(pixelFormat, maxWidth, maxHeight));
+
+        for (const auto& size : LADDER_SIZES) {
+            if (size[0] > maxWidth || size[1] > maxHeight)
+                continue;
+            if (size[0] == maxWidth && size[1] == maxHeight)
+                continue;
+            if (pixelFormatSupportsSize(pixelFormat, size[0], size[1]))
+                formats.append(VideoFormat(pixelFormat, size[0], size[1]));
+        }
+    }
+
+    return formats;
+}
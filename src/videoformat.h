@@ -0,0 +1,70 @@
+#ifndef VIDEOFORMAT_H
+#define VIDEOFORMAT_H
+
+#include <QDebug>
+#include <QString>
+#include <QVector>
+
+#include <cstddef>
+#include <cstdint>
+
+enum class PixelFormat {
+    Rgba32,
+    Rgb24,
+    Bgr24,
+    Yuyv,
+    Nv12,
+    Nv21,
+    I420,
+    // Encoded, frames vary in size up to pixelFormatFrameSize()
+    Mjpeg
+};
+
+// V4L2 fourcc advertised for the format
+uint32_t pixelFormatFourCC(PixelFormat format);
+
+// Bytes of a tightly packed frame (upper bound for compressed formats),
+// first plane line length (0 for compressed formats)
+size_t pixelFormatFrameSize(PixelFormat format, size_t width, size_t height);
+size_t pixelFormatBytesPerLine(PixelFormat format, size_t width);
+
+bool pixelFormatIsCompressed(PixelFormat format);
+
+// Whether width and height fit the format's subsampling and packing
+bool pixelFormatSupportsSize(PixelFormat format, size_t width, size_t height);
+
+QString pixelFormatName(PixelFormat format);
+bool parsePixelFormat(const QString& name, PixelFormat* format);
+bool pixelFormatFromFourCC(uint32_t fourcc, PixelFormat* format);
+
+// Parses WIDTHxHEIGHT
+bool parseFrameSize(const QString& value, size_t* width, size_t* height);
+
+// A complete frame format as negotiated between a source and a sink
+struct VideoFormat {
+    VideoFormat() {}
+    VideoFormat(PixelFormat pixelFormat, size_t width, size_t height) :
+        pixelFormat(pixelFormat), width(width), height(height) {}
+
+    bool isValid() const { return width > 0 && height > 0; }
+    size_t frameSize() const { return pixelFormatFrameSize(pixelFormat, width, height); }
+
+    bool operator==(const VideoFormat& other) const
+    {
+        return pixelFormat == other.pixelFormat && width == other.width && height == other.height;
+    }
+    bool operator!=(const VideoFormat& other) const { return !(*this == other); }
+
+    PixelFormat pixelFormat = PixelFormat::Rgba32;
+    size_t width = 0;
+    size_t height = 0;
+};
+
+QDebug operator<<(QDebug debug, const VideoFormat& format);
+
+// Every pixel format at common sizes up to maxWidth x maxHeight, plus that
+// size itself, skipping sizes a pixel format can't pack
+QVector<VideoFormat> videoFormatLadder(const QVector<PixelFormat>& pixelFormats,
+                                       size_t maxWidth, size_t maxHeight);
+
+#endif // VIDEOFORMAT_H